@@ -4,13 +4,12 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "globals.h"
 #include "Coxph.h"
 #include "utility.h"
 
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
@@ -38,7 +37,7 @@
 
    pivot1 = vmat.at(i, i);
 
-   if (pivot1 < R_PosInf && pivot1 > eps_chol) {
+   if (pivot1 < datum::inf && pivot1 > eps_chol) {
 
     for(j = (i+1); j < n_vars; j++){
 
@@ -176,13 +175,38 @@
                      double epsilon,
                      arma::uword iter_max){
 
+  TimeGroups groups;
+
+  find_time_groups(y_node, w_node, groups);
+
+  FitOptions options = {do_scale, ties_method, epsilon, iter_max,
+                        true, nullptr};
+
+  return(coxph_fit(x_node, y_node, w_node, groups, options));
+
+ }
+
+ arma::mat coxph_fit(arma::mat& x_node,
+                     arma::mat& y_node,
+                     arma::vec& w_node,
+                     const TimeGroups& groups,
+                     const FitOptions& options){
+
+  bool do_scale = options.do_scale;
+  int ties_method = options.ties_method;
+  double epsilon = options.epsilon;
+  uword iter_max = options.iter_max;
+
   uword
   person,
+  group,
   iter,
   i,
   j,
   k;
 
+  uword n_groups = groups.rank.n_elem;
+
   vec
   beta_current,
   beta_new,
@@ -200,11 +224,8 @@
   cmat2,
   x_transforms;
 
-  bool break_loop;
-
   double
    temp1,
-   temp2,
    halving,
    stat_best,
    denom,
@@ -268,8 +289,6 @@
   denom = 0;
   loglik = 0;
 
-  person = x_node.n_rows - 1;
-
   u.fill(0);
   a.fill(0);
   a2.fill(0);
@@ -278,22 +297,17 @@
   cmat2.fill(0);
 
 
-  // the outer loop needs to be broken when a condition occurs in
-  // the inner loop - set up a bool to break the outer loop
-  break_loop = false;
-
   // xb = 0.0;
 
-  for( ; ; ){
+  // walk backwards through the groups of tied times
+  for(group = n_groups; group-- > 0; ){
 
-   temp2 = y_node.at(person, 0); // time of event for current person
    n_events  = 0 ; // number of deaths at this time point
    weight_events = 0 ; // sum of w_node for the deaths
    denom_events = 0 ; // sum of weighted risks for the deaths
 
    // walk through this set of tied times
-   while(y_node.at(person, 0) == temp2){
-
+   for(person = groups.start[group+1]; person-- > groups.start[group]; ){
 
     risk = w_node.at(person);
 
@@ -337,13 +351,6 @@
 
     }
 
-    if(person == 0){
-     break_loop = true;
-     break;
-    }
-
-    person--;
-
    }
 
    // we need to add to the main terms
@@ -404,8 +411,6 @@
 
    }
 
-   if(break_loop) break;
-
   }
 
   stat_best = loglik;
@@ -416,23 +421,27 @@
   cholesky_solve(vmat, u);
   beta_new = beta_current + u;
 
+  if(options.n_iter) (*options.n_iter)++;
+
   // for fast cph, returned XB needs to be computed
   if(iter_max <= 1) XB = x_node * beta_new;
 
   // for standard cph, iterate until convergence
-  if(iter_max > 1 && stat_best < R_PosInf){
+  if(iter_max > 1 && stat_best < datum::inf){
 
    for(iter = 1; iter < iter_max; iter++){
 
+    if(options.n_iter) (*options.n_iter)++;
+
     // if(VERBOSITY > 1){
     //
-    //  Rcout << "--------- Newt-Raph algo; iter " << iter;
-    //  Rcout << " ---------"  << std::endl;
-    //  Rcout << "beta: "      << beta_new.t();
-    //  Rcout << "loglik:    " << stat_best;
-    //  Rcout                  << std::endl;
-    //  Rcout << "------------------------------------------";
-    //  Rcout << std::endl << std::endl << std::endl;
+    //  console() << "--------- Newt-Raph algo; iter " << iter;
+    //  console() << " ---------"  << std::endl;
+    //  console() << "beta: "      << beta_new.t();
+    //  console() << "loglik:    " << stat_best;
+    //  console()                  << std::endl;
+    //  console() << "------------------------------------------";
+    //  console() << std::endl << std::endl << std::endl;
     //
     // }
 
@@ -441,8 +450,6 @@
     denom = 0;
     loglik = 0;
 
-    person = x_node.n_rows - 1;
-
     u.fill(0);
     a.fill(0);
     a2.fill(0);
@@ -450,25 +457,19 @@
     cmat.fill(0);
     cmat2.fill(0);
 
-    // this loop has a strange break condition to accomodate
-    // the restriction that a uvec (uword) cannot be < 0
-
-    break_loop = false;
-
     // XB = x_node * beta_new;
     // Risk = exp(XB) % w_node;
 
 
-    for( ; ; ){
+    // walk backwards through the groups of tied times
+    for(group = n_groups; group-- > 0; ){
 
-     temp2 = y_node.at(person, 0); // time of event for current person
      n_events  = 0 ; // number of deaths at this time point
      weight_events = 0 ; // sum of w_node for the deaths
      denom_events = 0 ; // sum of weighted risks for the deaths
 
      // walk through this set of tied times
-     while(y_node.at(person, 0) == temp2){
-
+     for(person = groups.start[group+1]; person-- > groups.start[group]; ){
 
       // xb = XB.at(person);
       // risk = Risk.at(person);
@@ -522,13 +523,6 @@
 
       }
 
-      if(person == 0){
-       break_loop = true;
-       break;
-      }
-
-      person--;
-
      }
 
      // we need to add to the main terms
@@ -589,8 +583,6 @@
 
      }
 
-     if(break_loop) break;
-
     }
 
     stat_current = loglik;
@@ -642,10 +634,12 @@
   }
 
 
-  // invert vmat
-  cholesky_invert(vmat);
+  bool compute_pvalues = options.compute_pvalues;
+
+  // invert vmat (only needed for p-values)
+  if(compute_pvalues) cholesky_invert(vmat);
 
-  vec pvalues(beta_current.size());
+  vec pvalues(compute_pvalues ? beta_current.size() : 0);
 
   for (i=0; i < n_vars; i++) {
 
@@ -655,12 +649,21 @@
     beta_current[i] = 0;
    }
 
+   if(!compute_pvalues){
+    if(do_scale){
+     beta_current.at(i) *= scales[i];
+     x_node.col(i) /= scales.at(i);
+     x_node.col(i) += means.at(i);
+    }
+    continue;
+   }
+
    if(std::isinf(vmat.at(i, i)) || std::isnan(vmat.at(i, i))){
     vmat.at(i, i) = 1.0;
    }
 
-   pvalues[i] = R::pchisq(
-    pow(beta_current[i], 2) / vmat.at(i, i), 1, false, false
+   pvalues[i] = pchisq(
+    pow(beta_current[i], 2) / vmat.at(i, i), 1, false
    );
 
    if(do_scale){
@@ -674,6 +677,8 @@
 
   }
 
+  if(!compute_pvalues) return(beta_current);
+
   return(join_horiz(beta_current, pvalues));
 
  }
@@ -9,6 +9,7 @@
 
 #include <armadillo>
 #include "globals.h"
+#include "utility.h"
 
 
  namespace aorsf {
@@ -66,6 +67,16 @@
                      double epsilon,
                      arma::uword iter_max);
 
+ // same as above, with tie groups of y_node that were already found
+ // (see TimeGroups in utility.h). If options.compute_pvalues is
+ // false, the information matrix is not inverted and the output
+ // only has the coefficient column.
+ arma::mat coxph_fit(arma::mat& x_node,
+                     arma::mat& y_node,
+                     arma::vec& w_node,
+                     const TimeGroups& groups,
+                     const FitOptions& options);
+
  }
 
 #endif /* COXPH_H */
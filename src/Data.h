@@ -8,6 +8,7 @@
 #define DATA_H_
 
 #include <armadillo>
+#include <random>
 #include "globals.h"
 
  using namespace arma;
@@ -62,6 +63,15 @@
    return(w);
   }
 
+  arma::uvec& get_y_rank(){
+   return(y_rank);
+  }
+
+  // survival forests set this once before growing trees
+  void set_y_rank(arma::uvec ranks){
+   this->y_rank = ranks;
+  }
+
   arma::mat x_rows(arma::uvec& row_indices) {
    return(x.rows(row_indices));
   }
@@ -186,6 +196,10 @@
   // for multi-column ops (e.g., partial dependence)
   std::vector<arma::vec> saved_values;
 
+  // survival only: integer time rank of each row in y, so that tied
+  // times can be found without comparing doubles (see utility.h)
+  arma::uvec y_rank;
+
   bool has_weights;
 
  private:
@@ -1,17 +1,25 @@
 //  Forest.cpp
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "Forest.h"
 #include "Tree.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
 using namespace arma;
 
 namespace aorsf {
 
-Forest::Forest(){ }
+Forest::Forest() :
+ n_tree_loaded(0), n_obs(0), oobag_stop_tolerance(0), oobag_stop_window(0),
+ max_seconds(0), cancel(nullptr), grow_cancelled(false),
+ grow_bytes(0), grow_out_of_memory(false), checkpoint_every(0) { }
 
 void Forest::init(std::unique_ptr<Data> input_data,
-                  Rcpp::IntegerVector& tree_seeds,
+                  const std::vector<int>& tree_seeds,
                   arma::uword n_tree,
                   arma::uword mtry,
                   bool sample_with_replacement,
@@ -35,7 +43,7 @@ void Forest::init(std::unique_ptr<Data> input_data,
                   double lincomb_alpha,
                   arma::uword lincomb_df_target,
                   arma::uword lincomb_ties_method,
-                  Rcpp::RObject lincomb_R_function,
+                  LincombFunction lincomb_function,
                   // predictions
                   PredType pred_type,
                   bool pred_mode,
@@ -47,11 +55,12 @@ void Forest::init(std::unique_ptr<Data> input_data,
                   bool oobag_pred,
                   EvalType oobag_eval_type,
                   arma::uword oobag_eval_every,
-                  Rcpp::RObject oobag_R_function,
+                  EvalFunction oobag_eval_function,
                   uint n_thread,
                   int verbosity){
 
  this->data = std::move(input_data);
+ this->n_obs = this->data->n_rows;
  this->tree_seeds = tree_seeds;
  this->n_tree = n_tree;
  this->mtry = mtry;
@@ -72,7 +81,7 @@ void Forest::init(std::unique_ptr<Data> input_data,
  this->lincomb_alpha = lincomb_alpha;
  this->lincomb_df_target = lincomb_df_target;
  this->lincomb_ties_method = lincomb_ties_method;
- this->lincomb_R_function = lincomb_R_function;
+ this->lincomb_function = lincomb_function;
  this->pred_type = pred_type;
  this->pred_mode = pred_mode;
  this->pred_aggregate = pred_aggregate;
@@ -83,7 +92,7 @@ void Forest::init(std::unique_ptr<Data> input_data,
  this->oobag_pred = oobag_pred;
  this->oobag_eval_type = oobag_eval_type;
  this->oobag_eval_every = oobag_eval_every;
- this->oobag_R_function = oobag_R_function;
+ this->oobag_eval_function = oobag_eval_function;
  this->n_thread = n_thread;
  this->verbosity = verbosity;
 
@@ -100,12 +109,12 @@ void Forest::init(std::unique_ptr<Data> input_data,
  // # nocov start
  if(verbosity > 1){
 
-  Rcpp::Rcout << "------------ input data dimensions ------------" << std::endl;
-  Rcpp::Rcout << "N observations total: " << data->get_n_rows()    << std::endl;
-  Rcpp::Rcout << "N columns total: "      << data->get_n_cols_x()    << std::endl;
-  Rcpp::Rcout << "-----------------------------------------------";
-  Rcpp::Rcout << std::endl;
-  Rcpp::Rcout << std::endl;
+  console() << "------------ input data dimensions ------------" << std::endl;
+  console() << "N observations total: " << data->get_n_rows()    << std::endl;
+  console() << "N columns total: "      << data->get_n_cols_x()    << std::endl;
+  console() << "-----------------------------------------------";
+  console() << std::endl;
+  console() << std::endl;
 
  }
  // # nocov end
@@ -114,45 +123,365 @@ void Forest::init(std::unique_ptr<Data> input_data,
 
 void Forest::run(bool oobag){
 
+ run_start = time_now();
+ grow_cancelled = false;
+
+ // trees grown in steps have their importance computed in each step
+ bool grow_stepwise = false;
+
  if (grow_mode) { // if the forest hasn't been grown
 
+  // trees loaded by init_append() stay in memory while new ones grow
+  if(n_tree_loaded > 0) memory.add(compute_model_bytes().total());
+
   // plant first
   plant();
   // initialize
   init_trees();
-  // grow
-  grow();
 
-  // compute + evaluate out-of-bag predictions if oobag is true
-  if(oobag){
-   this->pred_values = predict(oobag);
+  // early stopping needs an aggregated oobag evaluation after each step
+  bool stop_early = oobag && oobag_stop_tolerance > 0 &&
+   oobag_eval_type != EVAL_NONE && pred_aggregate &&
+   pred_type != PRED_TERMINAL_NODES;
+
+  // a checkpoint has the oobag prediction sums of the trees it saves
+  bool checkpoint = !checkpoint_file.empty() && checkpoint_every > 0 &&
+   (!oobag || (pred_aggregate && pred_type != PRED_TERMINAL_NODES));
+
+  grow_stepwise = stop_early || checkpoint;
+
+  if(grow_stepwise){
+
+   grow_in_steps(stop_early);
+
+  } else {
+
+   // grow
+   memory.reset_peak();
+   TimePoint phase_start = time_now();
+   grow();
+   telemetry.time_grow = seconds_since(phase_start);
+   telemetry.peak_grow = memory.get_peak();
+
+   // compute + evaluate out-of-bag predictions if oobag is true
+   if(oobag){
+    memory.reset_peak();
+    phase_start = time_now();
+    this->pred_values = predict(oobag);
+    telemetry.time_predict = seconds_since(phase_start);
+    telemetry.peak_predict = memory.get_peak();
+   }
+
+  }
+
+  if(grow_cancelled && verbosity > 0){
+   console() << "Stopped growing after " << n_tree << " trees: ";
+   console() << "the time limit passed or training was cancelled.";
+   console() << std::endl;
   }
 
  } else { // if the forest was already grown
   // initialize trees
   init_trees();
+  // trees of a grown forest count toward every phase below
+  memory.add(compute_model_bytes().total());
  }
 
  // if using a grown forest for prediction
  if(pred_mode){
+  memory.reset_peak();
+  TimePoint phase_start = time_now();
   this->pred_values = predict(oobag);
+  telemetry.time_predict = seconds_since(phase_start);
+  telemetry.peak_predict = memory.get_peak();
  }
 
  // if using a grown forest for variable importance
- if(vi_type == VI_PERMUTE || vi_type == VI_NEGATE){
+ if((vi_type == VI_PERMUTE || vi_type == VI_NEGATE) && !grow_stepwise){
+  memory.reset_peak();
+  TimePoint phase_start = time_now();
   compute_oobag_vi();
+  telemetry.time_importance = seconds_since(phase_start);
+  telemetry.peak_importance = memory.get_peak();
  }
 
  // if using a grown forest for partial dependence
  if(pd_type == PD_SUMMARY || pd_type == PD_ICE){
+  memory.reset_peak();
+  TimePoint phase_start = time_now();
   this->pd_values = compute_dependence(oobag);
+  telemetry.time_dependence = seconds_since(phase_start);
+  telemetry.peak_dependence = memory.get_peak();
+ }
+
+ // a forest that finished growing does not need its checkpoint, and
+ // one that stopped early can be resumed from it
+ if(grow_mode && !checkpoint_file.empty() && !grow_cancelled){
+  std::remove(checkpoint_file.c_str());
+ }
+
+}
+
+void Forest::init_append(arma::uword n_tree_total,
+                         arma::mat& oobag_pred_sum,
+                         arma::mat& oobag_eval,
+                         arma::vec& vi_numer,
+                         arma::uvec& vi_denom){
+
+ this->n_tree_loaded = trees.size();
+
+ if(n_tree_total <= n_tree_loaded){
+  stop("n_tree must be greater than the number of trees already grown.");
+ }
+
+ if(tree_seeds.size() < n_tree_total){
+  stop("tree_seeds must have one seed for each tree.");
+ }
+
+ // leaf predictions have one column per tree, not a sum
+ if(oobag_pred && pred_type == PRED_TERMINAL_NODES){
+  stop("trees cannot be added to a forest with out-of-bag leaf predictions.");
+ }
+
+ // sums from the loaded trees must line up with the data
+ if(oobag_pred && oobag_pred_sum.n_rows != data->n_rows){
+  stop("out-of-bag predictions of the loaded trees do not match the data.");
+ }
+
+ if(vi_type != VI_NONE && vi_numer.n_elem != data->n_cols_x){
+  stop("variable importance of the loaded trees does not match the data.");
+ }
+
+ this->n_tree = n_tree_total;
+ this->grow_mode = true;
+ this->oobag_pred_sum = oobag_pred_sum;
+ this->oobag_eval = oobag_eval;
+
+ if(vi_type != VI_NONE){
+  this->vi_numer = vi_numer;
+  if(vi_type == VI_ANOVA) this->vi_denom = vi_denom;
+ }
+
+}
+
+void Forest::grow_in_steps(bool stop_early){
+
+ uword n_tree_max = n_tree;
+ uword n_tree_first = n_tree_loaded;
+ uword n_tree_done = n_tree_loaded;
+ uword n_tree_saved = n_tree_loaded;
+
+ // steps line up with rows of oobag_eval when stopping early
+ uword n_tree_step = stop_early ? oobag_eval_every : checkpoint_every;
+
+ uword n_steps = std::max<uword>(1, oobag_stop_window / oobag_eval_every);
+
+ bool oobag_vi = vi_type == VI_PERMUTE || vi_type == VI_NEGATE;
+
+ bool checkpoint = !checkpoint_file.empty() && checkpoint_every > 0;
+
+ // progress is shown once per step instead of once per phase
+ int verbosity_run = verbosity;
+ if(verbosity == 1) verbosity = 0;
+
+ bool converged = false;
+
+ while(n_tree_done < n_tree_max && !converged){
+
+  // the budget is also checked between steps (and between trees by grow)
+  if(n_tree_done > n_tree_first && grow_budget_spent()){
+   grow_cancelled = true;
+   break;
+  }
+
+  // the trees grown so far are treated like loaded trees (see
+  // init_append), so only the next step's trees are grown and
+  // predicted, and predict() starts from oobag_pred_sum.
+  n_tree_loaded = n_tree_done;
+  n_tree = std::min(n_tree_done + n_tree_step, n_tree_max);
+
+  memory.reset_peak();
+  TimePoint phase_start = time_now();
+  grow();
+  telemetry.time_grow += seconds_since(phase_start);
+  telemetry.peak_grow = std::max(telemetry.peak_grow, memory.get_peak());
+
+  // trees planted for later steps will not be grown, and predict()
+  // evaluates the last step in full once they are removed
+  if(grow_cancelled){
+   trees.resize(n_tree);
+   tree_seeds.resize(n_tree);
+  }
+
+  if(oobag){
+   memory.reset_peak();
+   phase_start = time_now();
+   this->pred_values = predict(true);
+   telemetry.time_predict += seconds_since(phase_start);
+   telemetry.peak_predict = std::max(telemetry.peak_predict, memory.get_peak());
+  }
+
+  if(oobag_vi){
+   memory.reset_peak();
+   phase_start = time_now();
+   compute_oobag_vi();
+   telemetry.time_importance += seconds_since(phase_start);
+   telemetry.peak_importance = std::max(telemetry.peak_importance,
+                                        memory.get_peak());
+  }
+
+  n_tree_done = n_tree;
+
+  if(grow_cancelled) break;
+
+  if(stop_early) converged = oobag_converged(n_steps);
+
+  if(checkpoint && !converged && n_tree_done < n_tree_max &&
+     n_tree_done - n_tree_saved >= checkpoint_every){
+   write_checkpoint(n_tree_max);
+   n_tree_saved = n_tree_done;
+  }
+
+  if(verbosity_run == 1){
+   console() << "Growing trees: " << n_tree_done << " of " << n_tree_max;
+   if(stop_early){
+    console() << ", out-of-bag evaluation: " << oobag_eval.at(oobag_eval.n_rows-1, 0);
+   }
+   console() << std::endl;
+  }
+
+  checkUserInterrupt();
+
  }
 
+ verbosity = verbosity_run;
+ n_tree_loaded = n_tree_first;
+
+ if(n_tree < n_tree_max){
+
+  // trees after n_tree were planted but not grown
+  trees.resize(n_tree);
+  tree_seeds.resize(n_tree);
+
+  if(verbosity > 0 && converged){
+   console() << "Stopped growing after " << n_tree << " trees: ";
+   console() << "out-of-bag evaluation converged." << std::endl;
+  }
+
+ }
+
+ set_thread_ranges(n_thread);
+
+}
+
+bool Forest::oobag_converged(arma::uword n_steps){
+
+ uword row_last = oobag_eval.n_rows - 1;
+
+ if(row_last < n_steps) return(false);
+
+ double stat_last = oobag_eval.at(row_last, 0);
+ double stat_prev = oobag_eval.at(row_last - n_steps, 0);
+
+ // e.g., not enough oobag rows yet to evaluate
+ if(!std::isfinite(stat_last) || !std::isfinite(stat_prev)) return(false);
+
+ // higher is better for every type of evaluation except MSE
+ double improvement = stat_last - stat_prev;
+
+ if(oobag_eval_type == EVAL_MSE) improvement = -improvement;
+
+ return(improvement < oobag_stop_tolerance);
+
+}
+
+void Forest::init_trace(){
+
+ trace = std::make_unique<TraceRecorder>(n_thread, DEFAULT_TRACE_EVENTS);
+
+}
+
+void Forest::write_trace(std::string file_path) const {
+
+ if(!trace) stop("no trace was recorded for this forest.");
+
+ trace->write_json(file_path);
+
+}
+
+void Forest::check_memory(double bytes, std::string what){
+
+ if(memory.fits(bytes)) return;
+
+ stop_memory(bytes, what);
+
+}
+
+void Forest::stop_memory(double bytes, std::string what){
+
+ double mb = 1024 * 1024;
+
+ std::stringstream msg;
+
+ msg << std::fixed << std::setprecision(1);
+ msg << "not enough memory to " << what << ": ";
+ msg << "needs " << bytes / mb << " MB, but only ";
+ msg << std::max(memory.get_limit() - memory.get_current(), 0.0) / mb;
+ msg << " MB of max_memory (" << memory.get_limit() / mb << " MB)";
+ msg << " is left.";
+
+ stop(msg.str());
+
+}
+
+double Forest::estimate_grow_bytes(){
+
+ // inbag copies of x, y, and w, plus node assignments (all rows
+ // can be inbag when sampling with replacement)
+ double result = data->n_rows * (data->n_cols_x + data->n_cols_y + 2);
+
+ // oobag_denom, vi_numer, and vi_denom
+ result += data->n_rows + 2 * data->n_cols_x;
+
+ result *= sizeof(double);
+
+ // Tree::grow() reserves cutpoint, child_left, coefficients, and
+ // leaves for max_nodes nodes (see Tree::compute_max_leaves). The
+ // weighted count of inbag rows is at most the larger of n_rows and
+ // the sum of the weights.
+ double n_obs_max = std::max<double>(data->n_rows, accu(data->get_w()));
+ double leaf_obs_min = std::max(1.0, std::min(leaf_min_obs, split_min_obs - 1));
+ double max_nodes = 2 * std::ceil(n_obs_max / leaf_obs_min) - 1;
+
+ result += max_nodes * (2 * sizeof(double) + sizeof(uword) +
+                        sizeof(arma::vec) + sizeof(arma::uvec) +
+                        sizeof(arma::vec));
+
+ return(result);
+
+}
+
+double Forest::estimate_vi_bytes(arma::uword tree_idx){
+
+ // the oobag data of a tree is copied once for the tree and once
+ // more for the Data object that is noised
+ double n_values = trees[tree_idx]->get_rows_oobag().n_elem *
+  (data->n_cols_x + data->n_cols_y + 1);
+
+ return(2 * n_values * sizeof(double));
+
+}
+
+void Forest::set_thread_ranges(uint n_parts){
+
+ thread_ranges.clear();
+ equalSplit(thread_ranges, n_tree_loaded, n_tree - 1, n_parts);
+
 }
 
 void Forest::init_trees(){
 
- // Rcpp::Rcout << "when init trees called:" << std::endl << oobag_denom << std::endl;
+ // console() << "when init trees called:" << std::endl << oobag_denom << std::endl;
 
  for(uword i = 0; i < n_tree; ++i){
 
@@ -177,8 +506,8 @@ void Forest::init_trees(){
                  lincomb_alpha,
                  lincomb_df_target,
                  lincomb_ties_method,
-                 lincomb_R_function,
-                 oobag_R_function,
+                 lincomb_function,
+                 oobag_eval_function,
                  oobag_eval_type,
                  verbosity);
 
@@ -188,18 +517,38 @@ void Forest::init_trees(){
 
 void Forest::grow() {
 
+ // each thread needs its own working memory, so use fewer
+ // threads if all of them would not fit in max_memory.
+ grow_bytes = estimate_grow_bytes();
+ grow_out_of_memory = false;
+
+ uint n_thread_grow = n_thread;
+
+ while(n_thread_grow > 1 && !memory.fits(n_thread_grow * grow_bytes)){
+  n_thread_grow--;
+ }
+
+ check_memory(grow_bytes, "grow trees");
+
+ telemetry.n_thread_grow = n_thread_grow;
+ telemetry.bytes_grow_thread = grow_bytes;
+
+ trees_grown.zeros(n_tree - n_tree_loaded);
+
  // Create thread ranges
- equalSplit(thread_ranges, 0, n_tree - 1, n_thread);
+ set_thread_ranges(n_thread_grow);
 
  // reset progress to 0
  progress = 0;
 
- if(n_thread == 1){
+ if(n_thread_grow == 1){
   // ensure safe usage of R functions and glmnet
   // by growing trees in a single thread.
   grow_single_thread(&oobag_denom,
                      &vi_numer,
                      &vi_denom);
+  drop_ungrown_trees();
+  set_thread_ranges(n_thread);
   return;
  }
 
@@ -209,15 +558,20 @@ void Forest::grow() {
 
  // containers
  std::vector<std::thread> threads;
- std::vector<vec> oobag_denom_threads(n_thread);
- std::vector<vec> vi_numer_threads(n_thread);
- std::vector<uvec> vi_denom_threads(n_thread);
+ std::vector<vec> oobag_denom_threads(n_thread_grow);
+ std::vector<vec> vi_numer_threads(n_thread_grow);
+ std::vector<uvec> vi_denom_threads(n_thread_grow);
+ std::vector<WlsWorkspace> wls_workspace_threads(n_thread_grow);
+
+ double copy_bytes = (data->n_rows + 2 * data->n_cols_x) * sizeof(double);
+
+ memory.add(n_thread_grow * copy_bytes);
 
  // reserve memory
- threads.reserve(n_thread);
+ threads.reserve(n_thread_grow);
 
  // begin multi-thread grow
- for (uint i = 0; i < n_thread; ++i) {
+ for (uint i = 0; i < n_thread_grow; ++i) {
 
   oobag_denom_threads[i].zeros(data->n_rows);
   vi_numer_threads[i].zeros(data->n_cols_x);
@@ -226,11 +580,12 @@ void Forest::grow() {
   threads.emplace_back(&Forest::grow_multi_thread, this, i,
                        &(oobag_denom_threads[i]),
                        &(vi_numer_threads[i]),
-                       &(vi_denom_threads[i]));
+                       &(vi_denom_threads[i]),
+                       &(wls_workspace_threads[i]));
  }
 
  if(verbosity == 1){
-  show_progress("Growing trees", n_tree);
+  show_progress("Growing trees", n_tree - n_tree_loaded);
  }
 
  // end multi-thread grow
@@ -240,11 +595,19 @@ void Forest::grow() {
 
  threads.clear();
 
+ drop_ungrown_trees();
+
+ set_thread_ranges(n_thread);
+
  if (aborted_threads > 0) {
   throw std::runtime_error("User interrupt.");
  }
 
- for(uint i = 0; i < n_thread; ++i){
+ if(grow_out_of_memory) stop_memory(grow_bytes, "grow trees");
+
+ TimePoint reduce_start = time_now();
+
+ for(uint i = 0; i < n_thread_grow; ++i){
   oobag_denom += oobag_denom_threads[i];
  }
 
@@ -252,7 +615,7 @@ void Forest::grow() {
 
  if(vi_type == VI_ANOVA){
 
-  for(uint i = 0; i < n_thread; ++i){
+  for(uint i = 0; i < n_thread_grow; ++i){
    vi_numer += vi_numer_threads[i];
    vi_denom += vi_denom_threads[i];
   }
@@ -262,6 +625,46 @@ void Forest::grow() {
 
  }
 
+ memory.remove(n_thread_grow * copy_bytes);
+
+ trace_span(n_thread, "reduce grow", 0, reduce_start);
+
+}
+
+bool Forest::grow_budget_spent() const {
+
+ if(cancel != nullptr && cancel->load()) return(true);
+
+ return(max_seconds > 0 && seconds_since(run_start) > max_seconds);
+
+}
+
+void Forest::drop_ungrown_trees(){
+
+ uword n_kept = n_tree_loaded;
+
+ for(uword i = n_tree_loaded; i < n_tree; ++i){
+
+  if(trees_grown[i - n_tree_loaded] == 0) continue;
+
+  if(n_kept < i){
+   trees[n_kept] = std::move(trees[i]);
+   tree_seeds[n_kept] = tree_seeds[i];
+  }
+
+  ++n_kept;
+
+ }
+
+ if(n_kept == n_tree) return;
+
+ // trees after n_tree (planted for later steps of
+ // grow_in_steps) keep their order
+ trees.erase(trees.begin() + n_kept, trees.begin() + n_tree);
+ tree_seeds.erase(tree_seeds.begin() + n_kept, tree_seeds.begin() + n_tree);
+
+ n_tree = n_kept;
+
 }
 
 void Forest::grow_single_thread(vec* oobag_denom_ptr,
@@ -275,19 +678,42 @@ void Forest::grow_single_thread(vec* oobag_denom_ptr,
 
  steady_clock::time_point start_time = steady_clock::now();
  steady_clock::time_point last_time = steady_clock::now();
- size_t max_progress = n_tree;
+ size_t max_progress = n_tree - n_tree_loaded;
 
- for (uint i = 0; i < n_tree; ++i) {
+ // reused by every tree grown in this thread
+ WlsWorkspace wls_workspace;
+
+ for (uint i = n_tree_loaded; i < n_tree; ++i) {
+
+  // the first tree is always grown so that the forest is not empty
+  if(i > n_tree_loaded && grow_budget_spent()){
+   grow_cancelled = true;
+   break;
+  }
+
+  // trees grown so far count toward max_memory, so the working
+  // memory of each tree is checked before it is reserved
+  check_memory(grow_bytes, "grow trees");
 
   if(verbosity > 1){
-   Rcpp::Rcout << "------------ Growing tree " << i << " --------------";
-   Rcpp::Rcout << std::endl;
-   Rcpp::Rcout << std::endl;
+   console() << "------------ Growing tree " << i << " --------------";
+   console() << std::endl;
+   console() << std::endl;
   }
 
+  TimePoint tree_start = time_now();
+
   // all three parameters were initialized in Forest::init,
   // so initialization isn't needed here.
-  trees[i]->grow(oobag_denom_ptr, vi_numer_ptr, vi_denom_ptr);
+  trees[i]->grow(oobag_denom_ptr, vi_numer_ptr, vi_denom_ptr,
+                 &wls_workspace, &memory);
+
+  trees_grown[i - n_tree_loaded] = 1;
+
+  // grown trees stay in memory until the forest is returned
+  memory.add(trees[i]->compute_model_bytes().total());
+
+  trace_span(0, "grow tree", i, tree_start);
 
   ++progress;
 
@@ -302,15 +728,15 @@ void Forest::grow_single_thread(vec* oobag_denom_ptr,
     seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
     uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
 
-    Rcpp::Rcout << "Growing trees: ";
-    Rcpp::Rcout << round(100 * relative_progress) << "%. ";
+    console() << "Growing trees: ";
+    console() << round(100 * relative_progress) << "%. ";
 
     if(progress < max_progress){
-     Rcpp::Rcout << "~ time remaining: ";
-     Rcpp::Rcout << beautifyTime(remaining_time) << ".";
+     console() << "~ time remaining: ";
+     console() << beautifyTime(remaining_time) << ".";
     }
 
-    Rcpp::Rcout << std::endl;
+    console() << std::endl;
 
     last_time = steady_clock::now();
 
@@ -318,7 +744,7 @@ void Forest::grow_single_thread(vec* oobag_denom_ptr,
 
   }
 
-  Rcpp::checkUserInterrupt();
+  checkUserInterrupt();
 
  }
 
@@ -328,14 +754,44 @@ void Forest::grow_single_thread(vec* oobag_denom_ptr,
 void Forest::grow_multi_thread(uint thread_idx,
                                vec* oobag_denom_ptr,
                                vec* vi_numer_ptr,
-                               uvec* vi_denom_ptr) {
+                               uvec* vi_denom_ptr,
+                               WlsWorkspace* wls_workspace_ptr) {
 
 
  if (thread_ranges.size() > thread_idx + 1) {
 
   for (uint i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
 
-   trees[i]->grow(oobag_denom_ptr, vi_numer_ptr, vi_denom_ptr);
+   // each thread grows at least one tree
+   if(i > thread_ranges[thread_idx] && grow_budget_spent()){
+    // count the trees this thread skips so that show_progress returns
+    std::unique_lock<std::mutex> lock(mutex);
+    grow_cancelled = true;
+    progress += thread_ranges[thread_idx + 1] - i;
+    condition_variable.notify_one();
+    return;
+   }
+
+   // as in grow_single_thread(), but errors can't be thrown from
+   // here, so grow() stops once all threads are done
+   if(!memory.fits(grow_bytes)){
+    std::unique_lock<std::mutex> lock(mutex);
+    grow_out_of_memory = true;
+    progress += thread_ranges[thread_idx + 1] - i;
+    condition_variable.notify_one();
+    return;
+   }
+
+   TimePoint tree_start = time_now();
+
+   trees[i]->grow(oobag_denom_ptr, vi_numer_ptr, vi_denom_ptr,
+                  wls_workspace_ptr, &memory);
+
+   trees_grown[i - n_tree_loaded] = 1;
+
+   memory.add(trees[i]->compute_model_bytes().total());
+
+   trace_span(thread_idx, "grow tree", i, tree_start);
 
    // Check for user interrupt
    if (aborted) {
@@ -385,7 +841,7 @@ void Forest::compute_oobag_vi() {
  }
 
  if(verbosity == 1){
-  show_progress("Computing importance", n_tree);
+  show_progress("Computing importance", n_tree - n_tree_loaded);
  }
 
  for (auto &thread : threads) {
@@ -398,12 +854,16 @@ void Forest::compute_oobag_vi() {
   throw std::runtime_error("User interrupt.");
  }
 
+ TimePoint reduce_start = time_now();
+
  for(uint i = 0; i < n_thread; ++i){
   vi_numer += vi_numer_threads[i];
  }
 
  vi_numer_threads.clear();
 
+ trace_span(n_thread, "reduce importance", 0, reduce_start);
+
 }
 
 void Forest::compute_oobag_vi_single_thread(vec* vi_numer_ptr) {
@@ -414,12 +874,22 @@ void Forest::compute_oobag_vi_single_thread(vec* vi_numer_ptr) {
 
  steady_clock::time_point start_time = steady_clock::now();
  steady_clock::time_point last_time = steady_clock::now();
- size_t max_progress = n_tree;
+ size_t max_progress = n_tree - n_tree_loaded;
+
+ for(uint i = n_tree_loaded; i < n_tree; ++i){
+
+  TimePoint tree_start = time_now();
+
+  double vi_bytes = estimate_vi_bytes(i);
 
- for(uint i = 0; i < n_tree; ++i){
+  memory.add(vi_bytes);
 
   trees[i]->compute_oobag_vi(vi_numer_ptr, vi_type);
 
+  memory.remove(vi_bytes);
+
+  trace_span(0, "importance tree", i, tree_start);
+
   ++progress;
 
   if(verbosity == 1){
@@ -433,15 +903,15 @@ void Forest::compute_oobag_vi_single_thread(vec* vi_numer_ptr) {
     seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
     uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
 
-    Rcpp::Rcout << "Computing importance: ";
-    Rcpp::Rcout << round(100 * relative_progress) << "%. ";
+    console() << "Computing importance: ";
+    console() << round(100 * relative_progress) << "%. ";
 
     if(progress < max_progress){
-     Rcpp::Rcout << "~ time remaining: ";
-     Rcpp::Rcout << beautifyTime(remaining_time) << ".";
+     console() << "~ time remaining: ";
+     console() << beautifyTime(remaining_time) << ".";
     }
 
-    Rcpp::Rcout << std::endl;
+    console() << std::endl;
 
     last_time = steady_clock::now();
 
@@ -449,7 +919,7 @@ void Forest::compute_oobag_vi_single_thread(vec* vi_numer_ptr) {
 
   }
 
-  Rcpp::checkUserInterrupt();
+  checkUserInterrupt();
 
  }
 
@@ -461,8 +931,18 @@ void Forest::compute_oobag_vi_multi_thread(uint thread_idx, vec* vi_numer_ptr) {
 
   for(uint i=thread_ranges[thread_idx]; i<thread_ranges[thread_idx+1]; ++i){
 
+   TimePoint tree_start = time_now();
+
+   double vi_bytes = estimate_vi_bytes(i);
+
+   memory.add(vi_bytes);
+
    trees[i]->compute_oobag_vi(vi_numer_ptr, vi_type);
 
+   memory.remove(vi_bytes);
+
+   trace_span(thread_idx, "importance tree", i, tree_start);
+
    // Check for user interrupt
    if (aborted) {
     std::unique_lock<std::mutex> lock(mutex);
@@ -486,6 +966,8 @@ void Forest::compute_prediction_accuracy(Data* prediction_data,
                                          arma::mat& prediction_values,
                                          arma::uword row_fill){
 
+ TimePoint eval_start = time_now();
+
  // avoid dividing by zero
  uvec valid_observations = find(oobag_denom > 0);
 
@@ -502,6 +984,9 @@ void Forest::compute_prediction_accuracy(Data* prediction_data,
  // pass along to forest-specific version
  compute_prediction_accuracy(y_valid, w_valid, p_valid, row_fill);
 
+ // this runs on the main thread, and may call an R function
+ trace_span(n_thread, "oobag eval", row_fill, eval_start);
+
 }
 
 
@@ -517,32 +1002,103 @@ void Forest::compute_prediction_accuracy(arma::mat&  y,
 
 std::vector<std::vector<arma::mat>> Forest::compute_dependence(bool oobag){
 
+ if(pd_type == PD_SUMMARY) return(compute_dependence_summary(oobag));
+
  std::vector<std::vector<mat>> result;
 
- resize_pd_mats(result);
+ // a single row is enough to find the columns of result
+ resize_pd_mats(result, 1);
 
  progress = 0;
  aborted = false;
  aborted_threads = 0;
 
+ uword n_cols_result = 0;
+
+ for(auto& result_k : result){
+  for(auto& result_k_j : result_k){
+   n_cols_result += result_k_j.n_cols;
+  }
+ }
+
+ double result_bytes = data->n_rows * n_cols_result * sizeof(double);
+
+ check_memory(result_bytes, "compute partial dependence");
+
+ result.clear();
+ resize_pd_mats(result, data->n_rows);
+
+ memory.add(result_bytes);
+
  if(n_thread == 1){
 
   compute_dependence_single_thread(data.get(), oobag, result);
 
+ } else if (use_row_threads(n_cols_result)) {
+
+  // each thread writes its own rows of result, so no copies are needed
+  std::vector<std::thread> threads;
+
+  threads.reserve(n_thread);
+
+  for (uint i = 0; i < n_thread; ++i) {
+   threads.emplace_back(&Forest::compute_dependence_multi_thread_rows,
+                        this, i, data.get(), oobag,
+                        std::ref(result));
+  }
+
+  if(verbosity == 1){
+   show_progress("Computing dependence", data->n_rows);
+  }
+
+  for (auto &thread : threads) {
+   thread.join();
+  }
+
+  threads.clear();
+
+  if (aborted_threads > 0) {
+   throw std::runtime_error("User interrupt.");
+  }
+
+  TimePoint reduce_start = time_now();
+
+  for(uword k = 0; k < pd_x_vals.size(); ++k){
+   for(uword j = 0; j < pd_x_vals[k].n_rows; ++j){
+    if(oobag){
+     result[k][j].each_col() /= oobag_denom;
+    } else {
+     result[k][j] /= n_tree;
+    }
+   }
+  }
+
+  trace_span(n_thread, "reduce dependence", 0, reduce_start);
+
+ } else if (!memory.fits(n_thread * result_bytes)) {
+
+  // not enough memory for a copy of result in each thread
+  compute_dependence_single_thread(data.get(), oobag, result);
+
  } else {
 
   std::vector<std::thread> threads;
   std::vector<std::vector<std::vector<mat>>> result_threads(n_thread);
+  std::vector<PartialDepBuffers> buffers_threads(n_thread);
+
+  memory.add(n_thread * result_bytes);
 
   threads.reserve(n_thread);
 
   for (uint i = 0; i < n_thread; ++i) {
 
-   resize_pd_mats(result_threads[i]);
+   resize_pd_mats(result_threads[i], data->n_rows);
 
    threads.emplace_back(&Forest::compute_dependence_multi_thread,
                         this, i, data.get(), oobag,
-                        std::ref(result_threads[i]));
+                        std::ref(result_threads[i]),
+                        0, data->n_rows - 1,
+                        std::ref(buffers_threads[i]));
   }
 
   if(verbosity == 1){
@@ -554,6 +1110,8 @@ std::vector<std::vector<arma::mat>> Forest::compute_dependence(bool oobag){
    thread.join();
   }
 
+  TimePoint reduce_start = time_now();
+
   uvec oobag_zeros = find(oobag_denom == 0);
   if(oobag_zeros.size() > 0){
    oobag_denom(oobag_zeros).fill(1.0);
@@ -579,13 +1137,306 @@ std::vector<std::vector<arma::mat>> Forest::compute_dependence(bool oobag){
    }
   }
 
+  result_threads.clear();
+
+  memory.remove(n_thread * result_bytes);
+
+  trace_span(n_thread, "reduce dependence", 0, reduce_start);
+
  }
 
+ memory.remove(result_bytes);
+
  return(result);
 
 }
 
-void Forest::compute_dependence_single_thread(
+std::vector<std::vector<arma::mat>> Forest::compute_dependence_summary(
+  bool oobag
+){
+
+ // Summary dependence only needs the mean and quantiles of each
+ // item's predictions, so instead of holding predictions for every
+ // row and item, rows are predicted one block at a time by all trees
+ // and each finished block is pushed into a running summary.
+
+ using std::chrono::steady_clock;
+ using std::chrono::duration_cast;
+ using std::chrono::seconds;
+ steady_clock::time_point start_time = steady_clock::now();
+ steady_clock::time_point last_time = steady_clock::now();
+
+ uword n_rows = data->n_rows;
+ uword n_specs = pd_x_vals.size();
+
+ mat pred_template;
+ resize_pred_mat(pred_template, 1);
+ uword n_outputs = pred_template.n_cols;
+
+ uword n_items_total = 0;
+ for(auto& x_vals : pd_x_vals) n_items_total += x_vals.n_rows;
+
+ uword block_size = DEFAULT_PD_BLOCK_VALUES /
+  std::max<uword>(n_items_total * n_outputs, 1);
+
+ if(block_size < 64) block_size = 64;
+ if(block_size > n_rows) block_size = n_rows;
+
+ // each thread holds predictions for one block, so blocks
+ // are made smaller if they don't fit in max_memory
+ double value_bytes = n_items_total * n_outputs * n_thread * sizeof(double);
+
+ while(block_size > 64 && !memory.fits(block_size * value_bytes)){
+  block_size = std::max<uword>(block_size / 2, 64);
+ }
+
+ double block_bytes = block_size * value_bytes;
+
+ check_memory(block_bytes, "compute partial dependence");
+
+ memory.add(block_bytes);
+
+ uword n_blocks = (n_rows + block_size - 1) / block_size;
+
+ PartialDepSketch sketches(n_specs);
+
+ for(uword k = 0; k < n_specs; ++k){
+
+  sketches[k].resize(pd_x_vals[k].n_rows);
+
+  for(auto& sketch_item : sketches[k]){
+   sketch_item.assign(n_outputs, QuantileSketch(DEFAULT_PD_SKETCH_SIZE));
+  }
+
+ }
+
+ // predictions for the current block, one set per thread
+ std::vector<std::vector<std::vector<mat>>> block_threads(n_thread);
+
+ // memory for each thread, re-used for every block and tree
+ std::vector<PartialDepBuffers> buffers_threads(n_thread);
+
+ for(uword b = 0; b < n_blocks; ++b){
+
+  uword row_first = b * block_size;
+  uword row_last = std::min(row_first + block_size, n_rows) - 1;
+
+  for(auto& block : block_threads){
+   block.clear();
+   resize_pd_mats(block, row_last - row_first + 1);
+  }
+
+  if(n_thread == 1){
+
+   for(uint i = 0; i < n_tree; ++i){
+
+    TimePoint tree_start = time_now();
+
+    trees[i] -> compute_dependence(data.get(), block_threads[0],
+                                   pd_type, pd_x_vals, pd_x_cols,
+                                   oobag, row_first, row_last,
+                                   buffers_threads[0]);
+
+    trace_span(0, "dependence tree", i, tree_start);
+
+   }
+
+   checkUserInterrupt();
+
+  } else {
+
+   progress = 0;
+   aborted = false;
+   aborted_threads = 0;
+
+   std::vector<std::thread> threads;
+   threads.reserve(n_thread);
+
+   for (uint i = 0; i < n_thread; ++i) {
+    threads.emplace_back(&Forest::compute_dependence_multi_thread,
+                         this, i, data.get(), oobag,
+                         std::ref(block_threads[i]),
+                         row_first, row_last,
+                         std::ref(buffers_threads[i]));
+   }
+
+   for (auto &thread : threads) {
+    thread.join();
+   }
+
+   threads.clear();
+
+   if(checkInterrupt()){
+    throw std::runtime_error("User interrupt.");
+   }
+
+   TimePoint reduce_start = time_now();
+
+   for(uint i = 1; i < n_thread; ++i){
+    for(uword k = 0; k < n_specs; ++k){
+     for(uword j = 0; j < pd_x_vals[k].n_rows; ++j){
+      block_threads[0][k][j] += block_threads[i][k][j];
+     }
+    }
+   }
+
+   trace_span(n_thread, "reduce dependence", row_first, reduce_start);
+
+  }
+
+  TimePoint summarize_start = time_now();
+
+  for(uword k = 0; k < n_specs; ++k){
+   for(uword j = 0; j < pd_x_vals[k].n_rows; ++j){
+
+    mat& block_k_j = block_threads[0][k][j];
+
+    for(uword o = 0; o < n_outputs; ++o){
+     for(uword r = 0; r < block_k_j.n_rows; ++r){
+
+      double denom = oobag ? oobag_denom[row_first + r] : n_tree;
+      double value = block_k_j.at(r, o) / denom;
+
+      // zeros and NaNs mark rows with no prediction,
+      // and are treated as missing when summarizing
+      if(value == 0 || std::isnan(value)) continue;
+
+      sketches[k][j][o].push(value);
+
+     }
+    }
+
+   }
+  }
+
+  trace_span(n_thread, "summarize block", row_first, summarize_start);
+
+  if(verbosity == 1){
+
+   seconds elapsed_time = duration_cast<seconds>(steady_clock::now() - last_time);
+
+   if (elapsed_time.count() > STATUS_INTERVAL || b == n_blocks - 1) {
+
+    double relative_progress = (double) (b+1) / (double) n_blocks;
+    seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
+    uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
+
+    console() << "Computing dependence: ";
+    console() << round(100 * relative_progress) << "%. ";
+
+    if(b < n_blocks - 1){
+     console() << "~ time remaining: ";
+     console() << beautifyTime(remaining_time) << ".";
+    }
+
+    console() << std::endl;
+
+    last_time = steady_clock::now();
+
+   }
+
+  }
+
+ }
+
+ memory.remove(block_bytes);
+
+ // result[k][j] has one row per output and columns for
+ // the mean followed by one quantile for each of pd_probs
+ std::vector<std::vector<mat>> result(n_specs);
+
+ for(uword k = 0; k < n_specs; ++k){
+
+  result[k].reserve(pd_x_vals[k].n_rows);
+
+  for(uword j = 0; j < pd_x_vals[k].n_rows; ++j){
+
+   mat smry(n_outputs, 1 + pd_probs.size());
+
+   for(uword o = 0; o < n_outputs; ++o){
+
+    smry.at(o, 0) = sketches[k][j][o].compute_mean();
+
+    for(uword p = 0; p < pd_probs.size(); ++p){
+     smry.at(o, p+1) = sketches[k][j][o].compute_quantile(pd_probs[p]);
+    }
+
+   }
+
+   result[k].push_back(smry);
+
+  }
+
+ }
+
+ return(result);
+
+}
+
+void Forest::compute_dependence_multi_thread_rows(
+  uint thread_idx,
+  Data* prediction_data,
+  bool oobag,
+  std::vector<std::vector<arma::mat>>& result
+){
+
+ if (thread_row_ranges.size() > thread_idx + 1) {
+
+  uword rows_begin = thread_row_ranges[thread_idx];
+  uword rows_end = thread_row_ranges[thread_idx + 1];
+
+  std::vector<std::vector<mat>> result_block;
+
+  // re-used for every block and tree in this thread
+  PartialDepBuffers buffers;
+
+  for(uword row_first = rows_begin;
+      row_first < rows_end;
+      row_first += DEFAULT_PRED_BLOCK_ROWS){
+
+   uword row_last = std::min(row_first + DEFAULT_PRED_BLOCK_ROWS,
+                             rows_end) - 1;
+
+   TimePoint block_start = time_now();
+
+   result_block.clear();
+   resize_pd_mats(result_block, row_last - row_first + 1);
+
+   for(uint i = 0; i < n_tree; ++i){
+    trees[i] -> compute_dependence(prediction_data, result_block,
+                                   pd_type, pd_x_vals, pd_x_cols,
+                                   oobag, row_first, row_last,
+                                   buffers);
+   }
+
+   for(uword k = 0; k < pd_x_vals.size(); ++k){
+    for(uword j = 0; j < pd_x_vals[k].n_rows; ++j){
+     result[k][j].rows(row_first, row_last) = result_block[k][j];
+    }
+   }
+
+   trace_span(thread_idx, "dependence rows", row_first, block_start);
+
+   // Check for user interrupt
+   if (aborted) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ++aborted_threads;
+    condition_variable.notify_one();
+    return;
+   }
+
+   // Increase progress by the rows in this block
+   std::unique_lock<std::mutex> lock(mutex);
+   progress += row_last - row_first + 1;
+   condition_variable.notify_one();
+
+  }
+
+ }
+
+}
+
+void Forest::compute_dependence_single_thread(
   Data* prediction_data,
   bool oobag,
   std::vector<std::vector<arma::mat>>& result
@@ -600,21 +1451,29 @@ void Forest::compute_dependence_single_thread(
 
  uword n_specs = pd_x_vals.size();
 
+ // re-used for every tree
+ PartialDepBuffers buffers;
+
  for (uint i = 0; i < n_tree; ++i) {
 
   if(verbosity > 1){
    if(oobag){
-    Rcpp::Rcout << "--- Computing oobag dependence: tree " << i << " ---";
+    console() << "--- Computing oobag dependence: tree " << i << " ---";
    } else {
-    Rcpp::Rcout << "------ Computing dependence: tree " << i << " -----";
+    console() << "------ Computing dependence: tree " << i << " -----";
    }
-   Rcpp::Rcout << std::endl;
-   Rcpp::Rcout << std::endl;
+   console() << std::endl;
+   console() << std::endl;
   }
 
+  TimePoint tree_start = time_now();
+
   trees[i] -> compute_dependence(prediction_data, result,
                                  pd_type, pd_x_vals, pd_x_cols,
-                                 oobag);
+                                 oobag, 0, prediction_data->n_rows - 1,
+                                 buffers);
+
+  trace_span(0, "dependence tree", i, tree_start);
 
   progress++;
 
@@ -629,15 +1488,15 @@ void Forest::compute_dependence_single_thread(
     seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
     uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
 
-    Rcpp::Rcout << "Computing dependence: ";
-    Rcpp::Rcout << round(100 * relative_progress) << "%. ";
+    console() << "Computing dependence: ";
+    console() << round(100 * relative_progress) << "%. ";
 
     if(progress < max_progress){
-     Rcpp::Rcout << "~ time remaining: ";
-     Rcpp::Rcout << beautifyTime(remaining_time) << ".";
+     console() << "~ time remaining: ";
+     console() << beautifyTime(remaining_time) << ".";
     }
 
-    Rcpp::Rcout << std::endl;
+    console() << std::endl;
 
     last_time = steady_clock::now();
 
@@ -663,16 +1522,24 @@ void Forest::compute_dependence_multi_thread(
   uint thread_idx,
   Data* prediction_data,
   bool oobag,
-  std::vector<std::vector<arma::mat>>& result_ptr
+  std::vector<std::vector<arma::mat>>& result_ptr,
+  arma::uword row_first,
+  arma::uword row_last,
+  PartialDepBuffers& buffers
 ){
 
  if (thread_ranges.size() > thread_idx + 1) {
 
   for (uint i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
 
+   TimePoint tree_start = time_now();
+
    trees[i] -> compute_dependence(prediction_data, result_ptr,
                                   pd_type, pd_x_vals, pd_x_cols,
-                                  oobag);
+                                  oobag, row_first, row_last,
+                                  buffers);
+
+   trace_span(thread_idx, "dependence tree", i, tree_start);
 
    // Check for user interrupt
    if (aborted) {
@@ -697,9 +1564,23 @@ mat Forest::predict(bool oobag) {
 
  mat result;
 
- // No. of cols in pred mat depend on the type of forest
+ // No. of cols in pred mat depend on the type of forest,
+ // and a single row is enough to find out how many
+ resize_pred_mat(result, 1);
+
+ double result_bytes = data->n_rows * result.n_cols * sizeof(double);
+
+ check_memory(result_bytes, "compute predictions");
+
  resize_pred_mat(result, data->n_rows);
 
+ memory.add(result_bytes);
+
+ // oobag predictions of loaded trees are already summed
+ if(oobag && grow_mode && n_tree_loaded > 0 && pred_aggregate){
+  result = oobag_pred_sum;
+ }
+
  // Slots to hold oobag prediction accuracy
  // (needs to be resized even if !oobag)
  resize_oobag_eval();
@@ -708,15 +1589,59 @@ mat Forest::predict(bool oobag) {
  aborted = false;
  aborted_threads = 0;
 
- if(n_thread == 1){
+ // oobag accuracy tracked while growing needs predictions
+ // from subsets of trees, so threads must split trees.
+ bool track_oobag_eval = oobag && grow_mode &&
+  oobag_eval_every < n_tree - n_tree_loaded;
+
+ // when threads split trees, the evaluation is tracked after joining
+ // each thread, which needs oobag_eval_every trees in each thread.
+ bool eval_by_thread = grow_mode && n_tree_loaded == 0 &&
+  n_tree / oobag_eval_every == n_thread;
+
+ if(n_thread == 1 || (track_oobag_eval && !eval_by_thread)){
 
   predict_single_thread(data.get(), oobag, result);
 
+ } else if (!track_oobag_eval && use_row_threads(result.n_cols)) {
+
+  // each thread writes its own rows of result, so no copies are needed
+  std::vector<std::thread> threads;
+
+  threads.reserve(n_thread);
+
+  for (uint i = 0; i < n_thread; ++i) {
+   threads.emplace_back(&Forest::predict_multi_thread_rows,
+                        this, i, data.get(), oobag,
+                        std::ref(result));
+  }
+
+  if(verbosity == 1){
+   show_progress("Computing predictions", data->n_rows);
+  }
+
+  for (auto &thread : threads) {
+   thread.join();
+  }
+
+  threads.clear();
+
+  if (aborted_threads > 0) {
+   throw std::runtime_error("User interrupt.");
+  }
+
+ } else if (!memory.fits(n_thread * result_bytes)) {
+
+  // not enough memory for a copy of result in each thread
+  predict_single_thread(data.get(), oobag, result);
+
  } else {
 
   std::vector<std::thread> threads;
   std::vector<mat> result_threads(n_thread);
 
+  memory.add(n_thread * result_bytes);
+
   threads.reserve(n_thread);
 
   for (uint i = 0; i < n_thread; ++i) {
@@ -729,7 +1654,7 @@ mat Forest::predict(bool oobag) {
   }
 
   if(verbosity == 1){
-   show_progress("Computing predictions", n_tree);
+   show_progress("Computing predictions", n_tree - n_tree_loaded);
   }
 
   // wait for all threads to finish before proceeding
@@ -739,6 +1664,8 @@ mat Forest::predict(bool oobag) {
 
   threads.clear();
 
+  TimePoint reduce_start = time_now();
+
   for(uint i = 0; i < n_thread; ++i){
 
    result += result_threads[i];
@@ -747,9 +1674,7 @@ mat Forest::predict(bool oobag) {
 
     // evaluate oobag error after joining each thread
     // (only safe to do this when the condition below holds)
-    if(grow_mode &&
-       n_tree/oobag_eval_every == n_thread &&
-       i < n_thread - 1){
+    if(eval_by_thread && i < n_thread - 1){
 
      // i should be uint to access threads,
      // eval_row should be uword to access oobag_eval
@@ -764,8 +1689,15 @@ mat Forest::predict(bool oobag) {
 
   result_threads.clear();
 
+  memory.remove(n_thread * result_bytes);
+
+  trace_span(n_thread, "reduce predict", 0, reduce_start);
+
  }
 
+ // the caller owns result from here on
+ memory.remove(result_bytes);
+
  if(pred_type == PRED_TERMINAL_NODES || !pred_aggregate){
   return(result);
  }
@@ -773,7 +1705,13 @@ mat Forest::predict(bool oobag) {
  if(oobag){
 
   if(grow_mode){
-   compute_prediction_accuracy(data.get(), result, oobag_eval.n_rows-1);
+   // a step of grow_in_steps() that ends between rows of oobag_eval
+   // leaves the last row to the step that reaches it
+   if(n_tree % oobag_eval_every == 0 || n_tree == trees.size()){
+    compute_prediction_accuracy(data.get(), result, oobag_eval.n_rows-1);
+   }
+   // kept so that more trees can be added later (see init_append)
+   oobag_pred_sum = result;
   }
 
   // it's okay if we divide by 0 here. It makes the result NaN but
@@ -795,6 +1733,303 @@ mat Forest::predict(bool oobag) {
 }
 
 
+void Forest::init_scorer(PredType pred_type){
+
+ this->pred_type = pred_type;
+ this->pred_mode = true;
+ this->pred_aggregate = true;
+ this->grow_mode = false;
+ this->vi_type = VI_NONE;
+ this->pd_type = PD_NONE;
+ this->oobag_pred = false;
+ this->n_thread = 1;
+ this->verbosity = 0;
+
+}
+
+arma::mat Forest::predict_batch(const arma::mat& x) const {
+
+ // Low latency scoring for a few rows at a time: rows are walked
+ // down each tree directly, without a Data copy of x, per-tree
+ // row lists, or sorting rows by leaf. Nothing in the forest is
+ // modified, so threads can share one forest and call this at
+ // the same time.
+
+ mat result;
+
+ resize_pred_mat(result, x.n_rows);
+
+ if(x.n_rows == 0) return(result);
+
+ // allocated once and re-used for every tree. For a few rows,
+ // grouping them by leaf costs more than it saves, so each row
+ // is its own group.
+ uvec leaves(x.n_rows);
+ uvec leaf_bounds = regspace<uvec>(0, 1, x.n_rows);
+ uvec rows_order = regspace<uvec>(0, 1, x.n_rows - 1);
+
+ // a column index that no node uses, i.e., negate nothing
+ uword negate_none = x.n_cols;
+
+ for(auto& tree : trees){
+
+  for(uword i = 0; i < x.n_rows; ++i){
+   leaves[i] = tree->predict_leaf_row(x, i, 0, negate_none);
+  }
+
+  tree->predict_value_internal(leaves, leaf_bounds, rows_order,
+                               result, pred_type, false);
+
+ }
+
+ result /= n_tree;
+
+ if(pred_type == PRED_CLASS){
+  predict_class(result);
+ }
+
+ return(result);
+
+}
+
+void Forest::write_binary(std::string file_path,
+                          std::vector<unsigned char>& metadata){
+
+ ForestFileWriter file(file_path);
+
+ write_binary_forest(file, metadata);
+
+ file.close();
+
+}
+
+void Forest::write_binary_forest(ForestFileWriter& file,
+                                 std::vector<unsigned char>& metadata){
+
+ ForestFileHeader header;
+
+ header.version   = FOREST_FILE_VERSION;
+ header.tree_type = get_tree_type();
+ header.n_tree    = n_tree;
+ header.n_obs     = n_obs;
+ header.n_class   = get_n_class();
+
+ file.write_header(header);
+ file.write_blob(metadata);
+ file.write_vec(oobag_denom);
+ file.write_vec(unique_event_times);
+
+ // trees after n_tree may be planted but not grown yet
+ for(uword i = 0; i < n_tree; ++i){
+  trees[i]->write_binary(file);
+ }
+
+}
+
+void Forest::load_binary(std::shared_ptr<MappedFile> file){
+
+ ForestFileReader reader(file);
+
+ read_binary_forest(reader);
+
+ this->mapped_file = file;
+
+ if(n_thread > 1){
+  equalSplit(thread_ranges, 0, n_tree - 1, n_thread);
+ }
+
+}
+
+void Forest::read_binary_forest(ForestFileReader& reader){
+
+ ForestFileHeader header = reader.read_header();
+
+ if(header.tree_type != get_tree_type()){
+  stop("forest file has a different type of trees than this forest.");
+ }
+
+ // metadata is for the caller, see orsf_read_binary_metadata_cpp()
+ reader.read_blob();
+
+ this->n_tree = header.n_tree;
+ this->n_obs = header.n_obs;
+ this->oobag_denom = reader.read_vec();
+ this->unique_event_times = reader.read_vec();
+
+ trees.clear();
+ trees.reserve(n_tree);
+
+ for(uword i = 0; i < n_tree; ++i){
+
+  // the order here must match Tree::write_binary()
+  uvec rows_oobag                      = reader.read_uvec();
+  std::vector<double> cutpoint         = reader.read_dbl_vector();
+  std::vector<uword> child_left        = reader.read_uword_vector();
+  std::vector<arma::vec> coef_values   = reader.read_vec_views();
+  std::vector<arma::uvec> coef_indices = reader.read_uvecs();
+  std::vector<double> leaf_summary     = reader.read_dbl_vector();
+
+  load_binary_tree(reader,
+                   std::move(rows_oobag),
+                   std::move(cutpoint),
+                   std::move(child_left),
+                   std::move(coef_values),
+                   std::move(coef_indices),
+                   std::move(leaf_summary));
+
+ }
+
+}
+
+// matrices in a checkpoint are stored as their number of rows
+// followed by their values in column-major order
+static void write_checkpoint_mat(ForestFileWriter& file, const mat& x){
+ file.write_u64(x.n_rows);
+ file.write_vec(vectorise(x));
+}
+
+static mat read_checkpoint_mat(ForestFileReader& reader){
+
+ uword n_rows = reader.read_u64();
+ vec values = reader.read_vec();
+
+ if(n_rows == 0) return(mat());
+
+ return(mat(values.memptr(), n_rows, values.n_elem / n_rows));
+
+}
+
+// FNV-1a, 64 bit
+static void hash_bytes(std::uint64_t& hash, const void* bytes, size_t n){
+
+ const unsigned char* p = static_cast<const unsigned char*>(bytes);
+
+ for(size_t i = 0; i < n; ++i){
+  hash ^= p[i];
+  hash *= 1099511628211ULL;
+ }
+
+}
+
+static void hash_mat(std::uint64_t& hash, const mat& x){
+
+ std::uint64_t dims[2] = {x.n_rows, x.n_cols};
+
+ hash_bytes(hash, dims, sizeof(dims));
+ hash_bytes(hash, x.memptr(), x.n_elem * sizeof(double));
+
+}
+
+std::uint64_t Forest::compute_data_checksum(){
+
+ std::uint64_t hash = 14695981039346656037ULL;
+
+ hash_mat(hash, data->get_x());
+ hash_mat(hash, data->get_y());
+ hash_mat(hash, data->get_w());
+
+ return(hash);
+
+}
+
+void Forest::write_checkpoint(arma::uword n_tree_total){
+
+ TimePoint write_start = time_now();
+
+ // written next to the checkpoint and then moved over it, so that
+ // the last checkpoint stays whole if writing is interrupted
+ std::string file_tmp = checkpoint_file + ".tmp";
+
+ ForestFileWriter file(file_tmp);
+
+ std::vector<unsigned char> metadata;
+
+ write_binary_forest(file, metadata);
+
+ // the order here must match resume_checkpoint()
+ file.write_u64(n_tree_total);
+ file.write_u64(checkpoint_every);
+ file.write_vector(std::vector<double>(tree_seeds.begin(),
+                                       tree_seeds.begin() + n_tree_total));
+ file.write_u64(compute_data_checksum());
+ write_checkpoint_mat(file, oobag_pred_sum);
+ write_checkpoint_mat(file, oobag_eval);
+ file.write_vec(vi_numer);
+ file.write_uvec(vi_denom);
+
+ file.close();
+
+ if(std::rename(file_tmp.c_str(), checkpoint_file.c_str()) != 0){
+
+  // rename() does not replace an existing file on every platform
+  std::remove(checkpoint_file.c_str());
+
+  if(std::rename(file_tmp.c_str(), checkpoint_file.c_str()) != 0){
+   stop("unable to write checkpoint to " + checkpoint_file);
+  }
+
+ }
+
+ trace_span(0, "write checkpoint", n_tree, write_start);
+
+}
+
+void Forest::resume_checkpoint(){
+
+ uword n_tree_total = n_tree;
+ uword n_obs_data = n_obs;
+
+ std::shared_ptr<MappedFile> file =
+  std::make_shared<MappedFile>(checkpoint_file);
+
+ ForestFileReader reader(file);
+
+ read_binary_forest(reader);
+
+ // the order here must match write_checkpoint()
+ uword n_tree_saved_total    = reader.read_u64();
+ uword saved_every           = reader.read_u64();
+ std::vector<double> seeds   = reader.read_dbl_vector();
+ std::uint64_t checksum      = reader.read_u64();
+ mat oobag_pred_sum_saved    = read_checkpoint_mat(reader);
+ mat oobag_eval_saved        = read_checkpoint_mat(reader);
+ vec vi_numer_saved          = reader.read_vec();
+ uvec vi_denom_saved         = reader.read_uvec();
+
+ bool same_forest = n_tree_saved_total == n_tree_total &&
+  saved_every == checkpoint_every &&
+  n_obs == n_obs_data &&
+  seeds.size() == n_tree_total &&
+  tree_seeds.size() >= n_tree_total &&
+  std::equal(seeds.begin(), seeds.end(), tree_seeds.begin());
+
+ if(!same_forest){
+  stop("checkpoint " + checkpoint_file +
+       " was written for a different forest.");
+ }
+
+ // rows_oobag and oobag_pred_sum refer to rows by position, so the
+ // data must match value for value and in the same order
+ if(checksum != compute_data_checksum()){
+  stop("checkpoint " + checkpoint_file +
+       " was written for different data.");
+ }
+
+ this->mapped_file = file;
+
+ if(verbosity > 0){
+  console() << "Resuming from checkpoint with " << trees.size();
+  console() << " of " << n_tree_total << " trees grown." << std::endl;
+ }
+
+ init_append(n_tree_total,
+             oobag_pred_sum_saved,
+             oobag_eval_saved,
+             vi_numer_saved,
+             vi_denom_saved);
+
+}
+
 void Forest::predict_single_thread(Data* prediction_data,
                                    bool oobag,
                                    mat& result) {
@@ -804,41 +2039,52 @@ void Forest::predict_single_thread(Data* prediction_data,
  using std::chrono::seconds;
  steady_clock::time_point start_time = steady_clock::now();
  steady_clock::time_point last_time = steady_clock::now();
- size_t max_progress = n_tree;
+ size_t max_progress = n_tree - n_tree_loaded;
 
- // Rcpp::Rcout << "init oobag_denom" << std::endl << oobag_denom << std::endl;
+ // console() << "init oobag_denom" << std::endl << oobag_denom << std::endl;
 
- for (uint i = 0; i < n_tree; ++i) {
+ // leaf predictions and their grouping for one tree,
+ // re-used for every tree
+ uvec leaves;
+ LeafGroups groups;
+
+ for (uint i = n_tree_loaded; i < n_tree; ++i) {
 
   if(verbosity > 1){
    if(oobag){
-    Rcpp::Rcout << "--- Computing oobag predictions: tree " << i << " ---";
+    console() << "--- Computing oobag predictions: tree " << i << " ---";
    } else {
-    Rcpp::Rcout << "------ Computing predictions: tree " << i << " -----";
+    console() << "------ Computing predictions: tree " << i << " -----";
    }
-   Rcpp::Rcout << std::endl;
-   Rcpp::Rcout << std::endl;
+   console() << std::endl;
+   console() << std::endl;
   }
 
 
-  trees[i]->predict_leaf(prediction_data, oobag);
+  TimePoint tree_start = time_now();
+
+  trees[i]->predict_leaf(prediction_data, oobag, leaves);
+
+  trace_span(0, "predict leaf", i, tree_start);
 
   if(pred_type == PRED_TERMINAL_NODES){
 
-   result.col(i) = conv_to<vec>::from(trees[i]->get_pred_leaf());
+   result.col(i) = conv_to<vec>::from(leaves);
 
   } else if (!pred_aggregate){
 
    vec col_i = result.unsafe_col(i);
-   trees[i]->predict_value(col_i, pred_type, oobag);
+   trees[i]->predict_value(leaves, col_i, pred_type, oobag, groups);
 
 
   } else {
 
-   trees[i]->predict_value(result, pred_type, oobag);
+   trees[i]->predict_value(leaves, result, pred_type, oobag, groups);
 
   }
 
+  trace_span(0, "predict tree", i, tree_start);
+
   progress++;
 
   if(verbosity == 1){
@@ -852,15 +2098,15 @@ void Forest::predict_single_thread(Data* prediction_data,
     seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
     uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
 
-    Rcpp::Rcout << "Computing predictions: ";
-    Rcpp::Rcout << round(100 * relative_progress) << "%. ";
+    console() << "Computing predictions: ";
+    console() << round(100 * relative_progress) << "%. ";
 
     if(progress < max_progress){
-     Rcpp::Rcout << "~ time remaining: ";
-     Rcpp::Rcout << beautifyTime(remaining_time) << ".";
+     console() << "~ time remaining: ";
+     console() << beautifyTime(remaining_time) << ".";
     }
 
-    Rcpp::Rcout << std::endl;
+    console() << std::endl;
 
     last_time = steady_clock::now();
 
@@ -868,12 +2114,14 @@ void Forest::predict_single_thread(Data* prediction_data,
 
   }
 
-  // Rcpp::Rcout << "oobag_denom: progress of " << progress << std::endl << oobag_denom << std::endl;
+  // console() << "oobag_denom: progress of " << progress << std::endl << oobag_denom << std::endl;
+
+  // if tracking oobag error over time (counting loaded trees):
+  uword n_tree_done = n_tree_loaded + progress;
 
-  // if tracking oobag error over time:
-  if(oobag && grow_mode && (progress%oobag_eval_every==0) && pred_aggregate){
+  if(oobag && grow_mode && (n_tree_done%oobag_eval_every==0) && pred_aggregate){
 
-   uword eval_row = (progress / oobag_eval_every) - 1;
+   uword eval_row = (n_tree_done / oobag_eval_every) - 1;
    // mat preds = result.each_col() / oobag_denom;
 
    compute_prediction_accuracy(prediction_data, result, eval_row);
@@ -891,25 +2139,35 @@ void Forest::predict_multi_thread(uint thread_idx,
 
  if (thread_ranges.size() > thread_idx + 1) {
 
+  // leaf predictions and their grouping are local to this thread
+  uvec leaves;
+  LeafGroups groups;
+
   for (uint i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
 
-   trees[i]->predict_leaf(prediction_data, oobag);
+   TimePoint tree_start = time_now();
+
+   trees[i]->predict_leaf(prediction_data, oobag, leaves);
+
+   trace_span(thread_idx, "predict leaf", i, tree_start);
 
    if(pred_type == PRED_TERMINAL_NODES){
 
-    result_ptr.col(i) = conv_to<vec>::from(trees[i]->get_pred_leaf());
+    result_ptr.col(i) = conv_to<vec>::from(leaves);
 
    } else if (!pred_aggregate){
 
     vec col_i = result_ptr.unsafe_col(i);
-    trees[i]->predict_value(col_i, pred_type, oobag);
+    trees[i]->predict_value(leaves, col_i, pred_type, oobag, groups);
 
    } else {
 
-    trees[i]->predict_value(result_ptr, pred_type, oobag);
+    trees[i]->predict_value(leaves, result_ptr, pred_type, oobag, groups);
 
    }
 
+   trace_span(thread_idx, "predict tree", i, tree_start);
+
    // Check for user interrupt
    if (aborted) {
     std::unique_lock<std::mutex> lock(mutex);
@@ -930,6 +2188,107 @@ void Forest::predict_multi_thread(uint thread_idx,
 
 }
 
+void Forest::predict_multi_thread_rows(uint thread_idx,
+                                       Data* prediction_data,
+                                       bool oobag,
+                                       mat& result) {
+
+ if (thread_row_ranges.size() > thread_idx + 1) {
+
+  uword rows_begin = thread_row_ranges[thread_idx];
+  uword rows_end = thread_row_ranges[thread_idx + 1];
+
+  uvec leaves;
+  LeafGroups groups;
+  mat result_block;
+
+  for(uword row_first = rows_begin;
+      row_first < rows_end;
+      row_first += DEFAULT_PRED_BLOCK_ROWS){
+
+   uword row_last = std::min(row_first + DEFAULT_PRED_BLOCK_ROWS,
+                             rows_end) - 1;
+
+   TimePoint block_start = time_now();
+
+   resize_pred_mat(result_block, row_last - row_first + 1);
+
+   for(uint i = n_tree_loaded; i < n_tree; ++i){
+
+    trees[i]->predict_leaf(prediction_data, oobag,
+                           row_first, row_last, leaves);
+
+    if(pred_type == PRED_TERMINAL_NODES){
+
+     result_block.col(i) = conv_to<vec>::from(leaves);
+
+    } else if (!pred_aggregate){
+
+     vec col_i = result_block.unsafe_col(i);
+     trees[i]->predict_value(leaves, col_i, pred_type, oobag, groups);
+
+    } else {
+
+     trees[i]->predict_value(leaves, result_block, pred_type, oobag, groups);
+
+    }
+
+   }
+
+   // += keeps the sums of loaded trees, if there are any
+   result.rows(row_first, row_last) += result_block;
+
+   trace_span(thread_idx, "predict rows", row_first, block_start);
+
+   // Check for user interrupt
+   if (aborted) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ++aborted_threads;
+    condition_variable.notify_one();
+    return;
+   }
+
+   // Increase progress by the rows in this block
+   std::unique_lock<std::mutex> lock(mutex);
+   progress += row_last - row_first + 1;
+   condition_variable.notify_one();
+
+  }
+
+ }
+
+}
+
+bool Forest::use_row_threads(arma::uword n_cols_result){
+
+ uword n_rows = data->n_rows;
+
+ // each thread should get at least one full block of rows
+ if(n_rows < n_thread * DEFAULT_PRED_BLOCK_ROWS) return(false);
+
+ bool use_rows = false;
+
+ // splitting trees would leave some threads idle
+ if(n_tree < n_thread) use_rows = true;
+
+ // splitting trees would need a copy of the result for each thread
+ if(n_rows * n_cols_result * n_thread > DEFAULT_PRED_THREAD_VALUES){
+  use_rows = true;
+ }
+
+ if(!memory.fits(n_rows * n_cols_result * n_thread * sizeof(double))){
+  use_rows = true;
+ }
+
+ if(use_rows){
+  thread_row_ranges.clear();
+  equalSplit(thread_row_ranges, 0, n_rows - 1, n_thread);
+ }
+
+ return(use_rows);
+
+}
+
 arma::uword Forest::find_max_eval_steps(){
 
  if(!oobag_pred) return(0);
@@ -952,7 +2311,7 @@ void Forest::resize_oobag_eval(){
 
 }
 
-void Forest::resize_pred_mat(arma::mat& p, arma::uword n){
+void Forest::resize_pred_mat(arma::mat& p, arma::uword n) const {
 
  if(pred_type == PRED_TERMINAL_NODES || !pred_aggregate){
 
@@ -966,7 +2325,8 @@ void Forest::resize_pred_mat(arma::mat& p, arma::uword n){
 
 }
 
-void Forest::resize_pd_mats(std::vector<std::vector<arma::mat>>& mat_list){
+void Forest::resize_pd_mats(std::vector<std::vector<arma::mat>>& mat_list,
+                            arma::uword n_rows){
 
  // a spec is a mat of x-values and umat of x-columns
  // e.g., x_vals = c(1,2,3) and x_cols = c(1,1,1)
@@ -994,7 +2354,7 @@ void Forest::resize_pd_mats(std::vector<std::vector<arma::mat>>& mat_list){
   for(uword j = 0; j < n_items; ++j){
    mat result_k_j;
 
-   resize_pred_mat(result_k_j, data->n_rows);
+   resize_pred_mat(result_k_j, n_rows);
 
    result_k.push_back(result_k_j);
   }
@@ -1037,15 +2397,15 @@ void Forest::show_progress(std::string operation, size_t max_progress) {
    seconds time_from_start = duration_cast<seconds>(steady_clock::now() - start_time);
    uint remaining_time = (1 / relative_progress - 1) * time_from_start.count();
 
-   Rcpp::Rcout << operation << ": ";
-   Rcpp::Rcout << round(100 * relative_progress) << "%. ";
+   console() << operation << ": ";
+   console() << round(100 * relative_progress) << "%. ";
 
    if(progress < max_progress){
-    Rcpp::Rcout << "~ time remaining: ";
-    Rcpp::Rcout << beautifyTime(remaining_time) << ".";
+    console() << "~ time remaining: ";
+    console() << beautifyTime(remaining_time) << ".";
    }
 
-   Rcpp::Rcout << std::endl;
+   console() << std::endl;
 
    last_time = steady_clock::now();
 
@@ -9,7 +9,11 @@
 #include "utility.h"
 #include "Tree.h"
 #include "TreeSurvival.h"
+#include "QuantileSketch.h"
+#include "ForestFile.h"
+#include "TraceRecorder.h"
 
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -34,7 +38,7 @@ public:
  // Methods
 
  void init(std::unique_ptr<Data> input_data,
-           Rcpp::IntegerVector& tree_seeds,
+           const std::vector<int>& tree_seeds,
            arma::uword n_tree,
            arma::uword mtry,
            bool sample_with_replacement,
@@ -58,7 +62,7 @@ public:
            double lincomb_alpha,
            arma::uword lincomb_df_target,
            arma::uword lincomb_ties_method,
-           Rcpp::RObject lincomb_R_function,
+           LincombFunction lincomb_function,
            // predictions
            PredType pred_type,
            bool pred_mode,
@@ -70,7 +74,7 @@ public:
            bool oobag_pred,
            EvalType oobag_eval_type,
            arma::uword oobag_eval_every,
-           Rcpp::RObject oobag_R_function,
+           EvalFunction oobag_eval_function,
            uint n_thread,
            int verbosity);
 
@@ -177,6 +181,106 @@ public:
 
  }
 
+ // telemetry of each tree from the last call to grow()
+ std::vector<TreeTelemetry> get_tree_telemetry() {
+
+  std::vector<TreeTelemetry> result;
+
+  result.reserve(n_tree);
+
+  for (auto& tree : trees) {
+   result.push_back(tree->get_telemetry());
+  }
+
+  return result;
+
+ }
+
+ ForestTelemetry& get_telemetry(){
+  return(telemetry);
+ }
+
+ // bytes held by the trees of the forest
+ ModelBytes compute_model_bytes() const {
+
+  ModelBytes result;
+
+  for (auto& tree : trees) {
+   result.add(tree->compute_model_bytes());
+  }
+
+  return result;
+
+ }
+
+ // upper bound on the memory accounted by MemoryTracker (bytes, 0
+ // for no limit). Threads are reduced or work is done in smaller
+ // pieces to stay under it, and run() stops with an error if that
+ // isn't enough.
+ void set_max_memory(double bytes){
+  memory.set_limit(bytes);
+ }
+
+ // stop growing trees once the out-of-bag evaluation improves by less
+ // than tolerance over the last window trees. The evaluation is checked
+ // every oobag_eval_every trees, so window is rounded down to a multiple
+ // of oobag_eval_every (and up to one step if it is smaller). A
+ // tolerance of 0 grows all n_tree trees. Call this after init().
+ void set_oobag_stop(double tolerance, arma::uword window){
+  this->oobag_stop_tolerance = tolerance;
+  this->oobag_stop_window = window;
+ }
+
+ // stop growing trees once max_seconds have passed since run() began
+ // (0 for no limit) or once *cancel is true, whichever comes first.
+ // Both are checked before each tree, and each thread grows at least
+ // one tree. The trees grown by then make up the forest, and their
+ // oobag predictions and importance are computed as usual. cancel may
+ // be set from any thread and must outlive run(). Call after init().
+ void set_grow_budget(double max_seconds,
+                      const std::atomic<bool>* cancel = nullptr){
+  this->max_seconds = max_seconds;
+  this->cancel = cancel;
+ }
+
+ // true if the last call to run() stopped growing trees early
+ // because of set_grow_budget()
+ bool get_grow_cancelled() const {
+  return(grow_cancelled);
+ }
+
+ // while growing, write the trees grown so far and the sums needed
+ // to grow the rest (oobag_denom, oobag prediction sums, oobag_eval,
+ // and importance) to file_path after every `every` trees. Trees are
+ // grown and scored `every` at a time (or oobag_eval_every at a time
+ // with set_oobag_stop), and the file is removed when run() finishes.
+ // Call after init().
+ void set_checkpoint(std::string file_path, arma::uword every){
+  this->checkpoint_file = file_path;
+  this->checkpoint_every = every;
+ }
+
+ // load the trees and sums from the file given to set_checkpoint() so
+ // that run() only grows the trees that were not saved. The file must
+ // have been written for this forest (same n_tree, tree_seeds, and
+ // data). Call after set_checkpoint() and before run().
+ void resume_checkpoint();
+
+ std::vector<int>& get_tree_seeds(){
+  return(tree_seeds);
+ }
+
+ // fewer than the n_tree given to init() if growth stopped early
+ arma::uword get_n_tree() const {
+  return(n_tree);
+ }
+
+ // record a timeline of the work each thread does in run() (see
+ // TraceRecorder.h). Call this after init().
+ void init_trace();
+
+ void write_trace(std::string file_path) const;
+
  void set_unique_event_times(arma::vec& x){
   this->unique_event_times = x;
  }
@@ -205,20 +309,65 @@ public:
   return(pred_values);
  }
 
+ // out-of-bag predictions summed over trees, before dividing by
+ // oobag_denom (only set when trees are grown)
+ arma::mat& get_oobag_pred_sum(){
+  return(oobag_pred_sum);
+ }
+
  std::vector<std::vector<arma::mat>>& get_pd_values(){
   return(pd_values);
  }
 
  void run(bool oobag);
 
+ // grow more trees into a forest that was loaded with load(), so
+ // that it has n_tree_total trees. The loaded trees are not grown,
+ // predicted, or scored again: their out-of-bag prediction sums,
+ // evaluation, and importance sums (from get_oobag_pred_sum() etc.
+ // when they were grown) are the starting values for the new trees.
+ // Call this after load() and before run().
+ void init_append(arma::uword n_tree_total,
+                  arma::mat& oobag_pred_sum,
+                  arma::mat& oobag_eval,
+                  arma::vec& vi_numer,
+                  arma::uvec& vi_denom);
+
  virtual void plant() = 0;
 
  void grow();
 
  arma::mat predict(bool oobag);
 
+ // settings for a loaded forest that is only used to score
+ // new rows with predict_batch(); call this before load()
+ void init_scorer(PredType pred_type);
+
+ arma::mat predict_batch(const arma::mat& x) const;
+
+ // write a loaded forest in the native binary format (ForestFile.h).
+ // metadata is stored as-is and can be read back with
+ // ForestFileReader::read_blob().
+ void write_binary(std::string file_path,
+                   std::vector<unsigned char>& metadata);
+
+ // load a forest written by write_binary(). Leaf tables and
+ // coefficients are used in place from the file's memory, so this
+ // forest keeps the file mapped for as long as it exists.
+ void load_binary(std::shared_ptr<MappedFile> file);
+
+ virtual TreeType get_tree_type() const = 0;
+
+ virtual arma::uword get_n_class() const {
+  return(0);
+ }
+
  std::vector<std::vector<arma::mat>> compute_dependence(bool oobag);
 
+ std::vector<std::vector<arma::mat>> compute_dependence_summary(bool oobag);
+
+ bool use_row_threads(arma::uword n_cols_result);
+
  void compute_dependence_single_thread(
    Data* prediction_data,
    bool oobag,
@@ -229,7 +378,17 @@ public:
    uint thread_idx,
    Data* prediction_data,
    bool oobag,
-   std::vector<std::vector<arma::mat>>& result_ptr
+   std::vector<std::vector<arma::mat>>& result_ptr,
+   arma::uword row_first,
+   arma::uword row_last,
+   PartialDepBuffers& buffers
+ );
+
+ void compute_dependence_multi_thread_rows(
+   uint thread_idx,
+   Data* prediction_data,
+   bool oobag,
+   std::vector<std::vector<arma::mat>>& result
  );
 
 protected:
@@ -243,7 +402,8 @@ protected:
  void grow_multi_thread(uint thread_idx,
                         vec* oobag_denom_ptr,
                         vec* vi_numer_ptr,
-                        uvec* vi_denom_ptr);
+                        uvec* vi_denom_ptr,
+                        WlsWorkspace* wls_workspace_ptr);
 
  void predict_single_thread(Data* prediction_data,
                             bool oobag,
@@ -254,6 +414,44 @@ protected:
                            bool oobag,
                            mat& result_ptr);
 
+ void predict_multi_thread_rows(uint thread_idx,
+                                Data* prediction_data,
+                                bool oobag,
+                                mat& result);
+
+ // grows trees a step at a time, adding their out-of-bag predictions
+ // and importance after each step, until n_tree trees are grown or,
+ // if stop_early is true, the out-of-bag evaluation converges (see
+ // set_oobag_stop). Steps have oobag_eval_every trees when stopping
+ // early and checkpoint_every trees otherwise. Trees that were not
+ // grown are removed.
+ void grow_in_steps(bool stop_early);
+
+ // writes the first n_tree trees and the sums that go with them to
+ // checkpoint_file (see set_checkpoint)
+ void write_checkpoint(arma::uword n_tree_total);
+
+ // the forest file layout that write_binary() and write_checkpoint()
+ // share, and the reader for it (see load_binary)
+ void write_binary_forest(ForestFileWriter& file,
+                          std::vector<unsigned char>& metadata);
+ void read_binary_forest(ForestFileReader& reader);
+
+ // used to check that a checkpoint was written for the same data
+ // (an FNV-1a hash of the dimensions and values of x, y, and w, so
+ // that reordered rows give a different result)
+ std::uint64_t compute_data_checksum();
+
+ // true if the last row of oobag_eval improved by less than
+ // oobag_stop_tolerance over the n_steps rows before it
+ bool oobag_converged(arma::uword n_steps);
+
+ // true if the budget from set_grow_budget() has run out
+ bool grow_budget_spent() const;
+
+ // removes trees that grow() skipped because the budget ran out
+ void drop_ungrown_trees();
+
  void compute_oobag_vi();
 
  void compute_oobag_vi_single_thread(vec* vi_numer_ptr);
@@ -262,26 +460,70 @@ protected:
 
  void show_progress(std::string operation, size_t max_progress);
 
- virtual void resize_pred_mat(arma::mat& p, arma::uword n);
+ // stops with an error if bytes more would pass max_memory
+ void check_memory(double bytes, std::string what);
+
+ // stops with the error that check_memory() gives
+ [[noreturn]] void stop_memory(double bytes, std::string what);
+
+ // working memory of one thread that grows trees, including the
+ // nodes and leaves reserved for the largest possible tree
+ double estimate_grow_bytes();
+
+ // oobag copies made by one tree to compute permutation importance
+ double estimate_vi_bytes(arma::uword tree_idx);
+
+ void set_thread_ranges(uint n_parts);
+
+ // adds a span that began at start to the trace, if there is one
+ void trace_span(uint thread_idx,
+                 const char* name,
+                 arma::uword id,
+                 TimePoint start){
+  if(trace) trace->record(thread_idx, name, id, start);
+ }
+
+ virtual void resize_pred_mat(arma::mat& p, arma::uword n) const;
 
- virtual void resize_pd_mats(std::vector<std::vector<arma::mat>>& mat_list);
+ virtual void resize_pd_mats(std::vector<std::vector<arma::mat>>& mat_list,
+                             arma::uword n_rows);
 
- virtual void resize_pred_mat_internal(arma::mat& p, arma::uword n) = 0;
+ virtual void resize_pred_mat_internal(arma::mat& p, arma::uword n) const = 0;
 
  arma::uword find_max_eval_steps();
 
  virtual void resize_oobag_eval();
 
+ // reads the leaf tables of one tree and adds the tree to the forest
+ virtual void load_binary_tree(ForestFileReader& reader,
+                               arma::uvec rows_oobag,
+                               std::vector<double> cutpoint,
+                               std::vector<arma::uword> child_left,
+                               std::vector<arma::vec> coef_values,
+                               std::vector<arma::uvec> coef_indices,
+                               std::vector<double> leaf_summary) = 0;
+
  // Member variables
 
  arma::uword n_tree;
+ // trees 0, ..., n_tree_loaded - 1 were loaded by init_append() and
+ // are skipped by grow(), oobag predictions, and oobag importance.
+ // Thread ranges only cover the trees after them.
+ arma::uword n_tree_loaded;
  arma::uword mtry;
  bool sample_with_replacement;
  double sample_fraction;
- Rcpp::IntegerVector tree_seeds;
+ std::vector<int> tree_seeds;
+
+ // memory used by trees from load_binary(). Declared before trees
+ // so that it is released after them.
+ std::shared_ptr<MappedFile> mapped_file;
 
  std::vector<std::unique_ptr<Tree>> trees;
 
+ // number of rows in the training data (set when a forest is loaded)
+ arma::uword n_obs;
+
  std::unique_ptr<Data> data;
 
  arma::vec unique_event_times;
@@ -313,7 +555,7 @@ protected:
  arma::uword lincomb_iter_max;
  arma::uword lincomb_df_target;
  arma::uword lincomb_ties_method;
- Rcpp::RObject     lincomb_R_function;
+ LincombFunction lincomb_function;
 
  bool grow_mode;
 
@@ -333,15 +575,38 @@ protected:
  // out-of-bag
  bool          oobag_pred;
  arma::vec     oobag_denom;
+ arma::mat     oobag_pred_sum;
  arma::mat     oobag_eval;
  EvalType      oobag_eval_type;
  arma::uword   oobag_eval_every;
- Rcpp::RObject oobag_R_function;
+ EvalFunction  oobag_eval_function;
+ double        oobag_stop_tolerance;
+ arma::uword   oobag_stop_window;
+
+ // grow budget (see set_grow_budget)
+ double                   max_seconds;
+ const std::atomic<bool>* cancel;
+ TimePoint                run_start;
+ bool                     grow_cancelled;
+ // 1 for each of the trees after n_tree_loaded that grow() finished
+ arma::uvec               trees_grown;
+
+ // estimate_grow_bytes() for the current call to grow(), which each
+ // tree checks against max_memory before it is grown
+ double grow_bytes;
+ // set by a thread that stopped because a tree did not fit
+ bool   grow_out_of_memory;
+
+ // checkpoints (see set_checkpoint)
+ std::string checkpoint_file;
+ arma::uword checkpoint_every;
 
 
  // multi-threading
  uint n_thread;
  std::vector<uint> thread_ranges;
+ // rows handled by each thread when threads split rows instead of trees
+ std::vector<uint> thread_row_ranges;
  std::mutex mutex;
  std::condition_variable condition_variable;
 
@@ -352,6 +617,14 @@ protected:
  // printing to console
  int verbosity;
 
+ // wall time and peak memory of each phase in run()
+ ForestTelemetry telemetry;
+
+ MemoryTracker memory;
+
+ // null unless init_trace() was called
+ std::unique_ptr<TraceRecorder> trace;
+
 
 };
 
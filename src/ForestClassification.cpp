@@ -1,13 +1,12 @@
 //  Forest.cpp
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "ForestClassification.h"
 #include "TreeClassification.h"
 
 #include <memory>
 
 using namespace arma;
-using namespace Rcpp;
 
 namespace aorsf {
 
@@ -20,13 +19,13 @@ ForestClassification::ForestClassification(arma::uword n_class){
 }
 
 void ForestClassification::resize_pred_mat_internal(arma::mat& p,
-                                                    arma::uword n){
+                                                    arma::uword n) const {
 
  p.zeros(n, this->n_class);
 
  if(verbosity > 3){
-  Rcout << "   -- pred mat size: " << p.n_rows << " rows by ";
-  Rcout << p.n_cols << " columns." << std::endl << std::endl;
+  console() << "   -- pred mat size: " << p.n_rows << " rows by ";
+  console() << p.n_cols << " columns." << std::endl << std::endl;
  }
 
 }
@@ -50,6 +49,7 @@ void ForestClassification::load(
 ) {
 
  this->n_tree    = n_tree;
+ this->n_obs     = n_obs;
  this->n_class   = n_class;
  this->pd_type   = pd_type;
  this->pd_x_vals = pd_x_vals;
@@ -58,8 +58,8 @@ void ForestClassification::load(
  this->oobag_denom = oobag_denom;
 
  if(verbosity > 2){
-  Rcout << "---- loading forest from input list ----";
-  Rcout << std::endl << std::endl;
+  console() << "---- loading forest from input list ----";
+  console() << std::endl << std::endl;
  }
 
  // Create trees
@@ -98,30 +98,17 @@ void ForestClassification::compute_prediction_accuracy_internal(
 
  if(oobag_eval_type == EVAL_R_FUNCTION){
 
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but Robjects can)
-  Rcpp::Function f_oobag_eval = Rcpp::as<Rcpp::Function>(oobag_R_function);
-
   // go through all columns if multi-class y,
   // but only go through one column if y is binary
   // uword start = 0;
   // if(n_class == 2) start = 1;
 
-  Rcpp::NumericVector w_ = Rcpp::wrap(w);
-
   for(uword i = 0; i < predictions.n_cols; ++i){
 
    vec y_i = y.unsafe_col(i);
    vec p_i = predictions.unsafe_col(i);
 
-   Rcpp::NumericVector y_ = Rcpp::wrap(y_i);
-   Rcpp::NumericVector p_ = Rcpp::wrap(p_i);
-
-   Rcpp::NumericVector R_result = f_oobag_eval(y_, w_, p_);
-
-   double result_addon = R_result[0];
-
-   result += result_addon;
+   result += oobag_eval_function(y_i, w, p_i);
 
   }
 
@@ -159,12 +146,38 @@ void ForestClassification::compute_prediction_accuracy_internal(
 
 }
 
+void ForestClassification::load_binary_tree(ForestFileReader& reader,
+                                            arma::uvec rows_oobag,
+                                            std::vector<double> cutpoint,
+                                            std::vector<arma::uword> child_left,
+                                            std::vector<arma::vec> coef_values,
+                                            std::vector<arma::uvec> coef_indices,
+                                            std::vector<double> leaf_summary){
+
+ // the order here must match TreeClassification::write_binary_leaves()
+ std::vector<arma::vec> leaf_pred_prob = reader.read_vec_views();
+
+ trees.push_back(
+  std::make_unique<TreeClassification>(n_obs,
+                                       n_class,
+                                       std::move(rows_oobag),
+                                       std::move(cutpoint),
+                                       std::move(child_left),
+                                       std::move(coef_values),
+                                       std::move(coef_indices),
+                                       std::move(leaf_pred_prob),
+                                       std::move(leaf_summary))
+ );
+
+}
+
 // growInternal() in ranger
 void ForestClassification::plant() {
 
  trees.reserve(n_tree);
 
- for (arma::uword i = 0; i < n_tree; ++i) {
+ // loaded trees (see init_append) are already in trees
+ for (arma::uword i = trees.size(); i < n_tree; ++i) {
   trees.push_back(std::make_unique<TreeClassification>(this->n_class));
  }
 
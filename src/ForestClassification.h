@@ -41,7 +41,7 @@ public:
    arma::vec& pd_probs
  );
 
- void resize_pred_mat_internal(arma::mat& p, arma::uword n) override;
+ void resize_pred_mat_internal(arma::mat& p, arma::uword n) const override;
 
  void compute_prediction_accuracy_internal(
    arma::mat& y,
@@ -55,8 +55,26 @@ public:
 
  std::vector<std::vector<arma::vec>> get_leaf_pred_prob();
 
+ TreeType get_tree_type() const override {
+  return(TREE_CLASSIFICATION);
+ }
+
+ arma::uword get_n_class() const override {
+  return(n_class);
+ }
+
  uword n_class;
 
+protected:
+
+ void load_binary_tree(ForestFileReader& reader,
+                       arma::uvec rows_oobag,
+                       std::vector<double> cutpoint,
+                       std::vector<arma::uword> child_left,
+                       std::vector<arma::vec> coef_values,
+                       std::vector<arma::uvec> coef_indices,
+                       std::vector<double> leaf_summary) override;
+
 };
 
 }
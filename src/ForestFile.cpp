@@ -0,0 +1,428 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#include "Runtime.h"
+#include "ForestFile.h"
+
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ using namespace arma;
+
+ namespace aorsf {
+
+ // the format is little-endian, and values are copied to and from
+ // the file as they are laid out in memory
+ static void check_byte_order(){
+
+  std::uint64_t value = FOREST_FILE_BYTE_ORDER;
+  unsigned char first_byte;
+  std::memcpy(&first_byte, &value, 1);
+
+  if(first_byte != 0x08){
+   stop("forest files can only be used on little-endian platforms.");
+  }
+
+ }
+
+ MappedFile::MappedFile(const std::string& file_path) :
+  data(nullptr),
+  size(0),
+  mapped(false){
+
+ #if !defined(_WIN32)
+
+  int fd = open(file_path.c_str(), O_RDONLY);
+
+  if(fd < 0) stop("unable to open " + file_path);
+
+  struct stat file_info;
+
+  if(fstat(fd, &file_info) != 0){
+   ::close(fd);
+   stop("unable to read " + file_path);
+  }
+
+  size = file_info.st_size;
+
+  if(size > 0){
+
+   // private, writable pages are shared with other processes until
+   // written to, and writes are never carried through to the file.
+   void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE, fd, 0);
+
+   if(address != MAP_FAILED){
+    data = static_cast<char*>(address);
+    mapped = true;
+   }
+
+  }
+
+  ::close(fd);
+
+  if(mapped || size == 0) return;
+
+ #endif
+
+  // fallback: read the whole file
+  std::ifstream stream(file_path, std::ios::binary | std::ios::ate);
+
+  if(!stream) stop("unable to open " + file_path);
+
+  size = stream.tellg();
+  stream.seekg(0);
+
+  buffer.resize(size);
+
+  if(size > 0 && !stream.read(buffer.data(), size)){
+   stop("unable to read " + file_path);
+  }
+
+  data = buffer.data();
+
+ }
+
+ MappedFile::~MappedFile(){
+
+ #if !defined(_WIN32)
+  if(mapped) munmap(data, size);
+ #endif
+
+ }
+
+ ForestFileWriter::ForestFileWriter(const std::string& file_path) :
+  file_path(file_path){
+
+  check_byte_order();
+
+  stream.open(file_path, std::ios::binary | std::ios::trunc);
+
+  if(!stream) stop("unable to open " + file_path + " for writing");
+
+ }
+
+ void ForestFileWriter::write_header(const ForestFileHeader& header){
+
+  stream.write(FOREST_FILE_MAGIC, sizeof(FOREST_FILE_MAGIC));
+
+  write_u64(header.version);
+  write_u64(FOREST_FILE_BYTE_ORDER);
+  write_u64(header.tree_type);
+  write_u64(header.n_tree);
+  write_u64(header.n_obs);
+  write_u64(header.n_class);
+
+ }
+
+ void ForestFileWriter::write_u64(std::uint64_t value){
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+ }
+
+ void ForestFileWriter::write_double(double value){
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+ }
+
+ void ForestFileWriter::write_blob(const std::vector<unsigned char>& blob){
+
+  write_u64(blob.size());
+
+  stream.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+
+  write_padding(blob.size());
+
+ }
+
+ void ForestFileWriter::write_padding(std::size_t n_bytes){
+
+  std::size_t n_pad = (8 - n_bytes % 8) % 8;
+  const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  stream.write(padding, n_pad);
+
+ }
+
+ void ForestFileWriter::write_vec(const arma::vec& x){
+
+  write_u64(x.n_elem);
+
+  stream.write(reinterpret_cast<const char*>(x.memptr()),
+               x.n_elem * sizeof(double));
+
+ }
+
+ void ForestFileWriter::write_uvec(const arma::uvec& x){
+
+  write_u64(x.n_elem);
+
+  for(auto& value : x) write_u64(value);
+
+ }
+
+ void ForestFileWriter::write_u32_vec(const arma::Col<arma::u32>& x){
+
+  write_u64(x.n_elem);
+
+  stream.write(reinterpret_cast<const char*>(x.memptr()),
+               x.n_elem * sizeof(arma::u32));
+
+  write_padding(x.n_elem * sizeof(arma::u32));
+
+ }
+
+ void ForestFileWriter::write_vector(const std::vector<double>& x){
+
+  write_u64(x.size());
+
+  stream.write(reinterpret_cast<const char*>(x.data()),
+               x.size() * sizeof(double));
+
+ }
+
+ void ForestFileWriter::write_vector(const std::vector<arma::uword>& x){
+
+  write_u64(x.size());
+
+  for(auto& value : x) write_u64(value);
+
+ }
+
+ void ForestFileWriter::write_vecs(const std::vector<arma::vec>& x){
+
+  write_u64(x.size());
+
+  for(auto& x_i : x) write_vec(x_i);
+
+ }
+
+ void ForestFileWriter::write_uvecs(const std::vector<arma::uvec>& x){
+
+  write_u64(x.size());
+
+  for(auto& x_i : x) write_uvec(x_i);
+
+ }
+
+ void ForestFileWriter::close(){
+
+  stream.close();
+
+  if(stream.fail()) stop("unable to finish writing " + file_path);
+
+ }
+
+ ForestFileReader::ForestFileReader(std::shared_ptr<MappedFile> file) :
+  file(file),
+  position(0){
+
+  check_byte_order();
+
+ }
+
+ const char* ForestFileReader::take(std::size_t n_bytes){
+
+  if(n_bytes > file->get_size() - position){
+   stop("forest file is truncated or corrupt.");
+  }
+
+  const char* out = file->get_data() + position;
+
+  position += n_bytes;
+
+  return(out);
+
+ }
+
+ std::uint64_t ForestFileReader::read_length(std::size_t value_size){
+
+  std::uint64_t n = read_u64();
+
+  // a corrupt length could overflow n * value_size
+  if(n > (file->get_size() - position) / value_size){
+   stop("forest file is truncated or corrupt.");
+  }
+
+  return(n);
+
+ }
+
+ ForestFileHeader ForestFileReader::read_header(){
+
+  const char* magic = take(sizeof(FOREST_FILE_MAGIC));
+
+  if(std::memcmp(magic, FOREST_FILE_MAGIC, sizeof(FOREST_FILE_MAGIC)) != 0){
+   stop("file was not written by orsf_save_binary().");
+  }
+
+  ForestFileHeader header;
+
+  header.version = read_u64();
+
+  if(header.version > FOREST_FILE_VERSION){
+   stop("forest file was written by a newer version of aorsf.");
+  }
+
+  // the layout of older files is not read, see FOREST_FILE_VERSION
+  if(header.version < FOREST_FILE_VERSION){
+   stop("forest file was written by an older version of aorsf; "
+        "save the forest again with orsf_save_binary().");
+  }
+
+  if(read_u64() != FOREST_FILE_BYTE_ORDER){
+   stop("forest file has an unexpected byte order.");
+  }
+
+  header.tree_type = (TreeType) read_u64();
+  header.n_tree    = read_u64();
+  header.n_obs     = read_u64();
+  header.n_class   = read_u64();
+
+  return(header);
+
+ }
+
+ std::uint64_t ForestFileReader::read_u64(){
+
+  std::uint64_t value;
+  std::memcpy(&value, take(sizeof(value)), sizeof(value));
+  return(value);
+
+ }
+
+ double ForestFileReader::read_double(){
+
+  double value;
+  std::memcpy(&value, take(sizeof(value)), sizeof(value));
+  return(value);
+
+ }
+
+ std::vector<unsigned char> ForestFileReader::read_blob(){
+
+  std::uint64_t n_bytes = read_length(1);
+
+  const char* start = take(n_bytes);
+
+  take((8 - n_bytes % 8) % 8);
+
+  return(std::vector<unsigned char>(start, start + n_bytes));
+
+ }
+
+ arma::vec ForestFileReader::read_vec_view(){
+
+  std::uint64_t n = read_length(sizeof(double));
+
+  // positions are multiples of 8 and mapped memory is page aligned,
+  // so these doubles are properly aligned
+  const char* start = take(n * sizeof(double));
+
+  if(n == 0) return(vec());
+
+  double* values = reinterpret_cast<double*>(const_cast<char*>(start));
+
+  // strict = true keeps the vec tied to this memory, i.e., it can't
+  // be resized and it never frees the memory.
+  return(vec(values, n, false, true));
+
+ }
+
+ arma::Col<arma::u32> ForestFileReader::read_u32_vec_view(){
+
+  std::uint64_t n = read_length(sizeof(arma::u32));
+
+  const char* start = take(n * sizeof(arma::u32));
+
+  take((8 - (n * sizeof(arma::u32)) % 8) % 8);
+
+  if(n == 0) return(arma::Col<arma::u32>());
+
+  arma::u32* values = reinterpret_cast<arma::u32*>(const_cast<char*>(start));
+
+  return(arma::Col<arma::u32>(values, n, false, true));
+
+ }
+
+ arma::vec ForestFileReader::read_vec(){
+
+  std::uint64_t n = read_length(sizeof(double));
+
+  vec out(n);
+
+  std::memcpy(out.memptr(), take(n * sizeof(double)), n * sizeof(double));
+
+  return(out);
+
+ }
+
+ arma::uvec ForestFileReader::read_uvec(){
+
+  std::uint64_t n = read_length(sizeof(std::uint64_t));
+
+  uvec out(n);
+
+  for(uword i = 0; i < n; ++i) out[i] = read_u64();
+
+  return(out);
+
+ }
+
+ std::vector<double> ForestFileReader::read_dbl_vector(){
+
+  std::uint64_t n = read_length(sizeof(double));
+
+  std::vector<double> out(n);
+
+  std::memcpy(out.data(), take(n * sizeof(double)), n * sizeof(double));
+
+  return(out);
+
+ }
+
+ std::vector<arma::uword> ForestFileReader::read_uword_vector(){
+
+  std::uint64_t n = read_length(sizeof(std::uint64_t));
+
+  std::vector<arma::uword> out(n);
+
+  for(uword i = 0; i < n; ++i) out[i] = read_u64();
+
+  return(out);
+
+ }
+
+ std::vector<arma::vec> ForestFileReader::read_vec_views(){
+
+  std::uint64_t n = read_length(sizeof(std::uint64_t));
+
+  std::vector<arma::vec> out;
+  out.reserve(n);
+
+  for(uword i = 0; i < n; ++i) out.push_back(read_vec_view());
+
+  return(out);
+
+ }
+
+ std::vector<arma::uvec> ForestFileReader::read_uvecs(){
+
+  std::uint64_t n = read_length(sizeof(std::uint64_t));
+
+  std::vector<arma::uvec> out;
+  out.reserve(n);
+
+  for(uword i = 0; i < n; ++i) out.push_back(read_uvec());
+
+  return(out);
+
+ }
+
+ } // namespace aorsf
@@ -0,0 +1,184 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#ifndef FORESTFILE_H_
+#define FORESTFILE_H_
+
+#include <armadillo>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "globals.h"
+
+ namespace aorsf {
+
+ // Native binary format for a trained forest
+ //
+ // @description a forest file is a flat sequence of little-endian,
+ //   8-byte values, so every double in the file is 8-byte aligned
+ //   relative to the start of the file:
+ //
+ //   - header: magic bytes, format version, byte order mark,
+ //     tree type, n_tree, n_obs, n_class
+ //   - metadata: a length-prefixed blob that the caller owns
+ //     (R stores the serialized predictor info here)
+ //   - oobag_denom and unique_event_times
+ //   - for each tree: rows_oobag, cutpoint, child_left, coef_values,
+ //     coef_indices, leaf_summary, and then the leaf tables of its
+ //     tree type (e.g., leaf_pred_offset, leaf_pred_indx,
+ //     leaf_pred_prob and leaf_pred_chaz for survival trees).
+ //
+ //   A vector is written as its length followed by its values.
+ //   Doubles and 32 bit indices can be read in place from a memory
+ //   mapped file. Other indices are stored as 64 bit integers and are
+ //   copied when read because arma::uword may be 32 bits.
+
+ const char FOREST_FILE_MAGIC[8] = {'A', 'O', 'R', 'S', 'F', 'B', 'I', 'N'};
+
+ // increment when the layout changes; readers refuse other versions.
+ // Version 2 stores survival leaves as offsets into one table of
+ // indices into unique_event_times (version 1 nested them by leaf).
+ const std::uint64_t FOREST_FILE_VERSION = 2;
+
+ const std::uint64_t FOREST_FILE_BYTE_ORDER = 0x0102030405060708;
+
+ struct ForestFileHeader {
+  std::uint64_t version;
+  TreeType tree_type;
+  arma::uword n_tree;
+  arma::uword n_obs;
+  arma::uword n_class;
+ };
+
+ // read-only view of a file's bytes
+ //
+ // @description uses mmap where available, so processes that load
+ //   the same file share its pages in the OS page cache. On other
+ //   platforms, the file is read into memory instead. Pages are
+ //   mapped copy-on-write, so nothing written through the mapping
+ //   can reach the file.
+ class MappedFile {
+
+ public:
+
+  MappedFile(const std::string& file_path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* get_data() const {
+   return(data);
+  }
+
+  std::size_t get_size() const {
+   return(size);
+  }
+
+ private:
+
+  char* data;
+  std::size_t size;
+
+  bool mapped;
+
+  // only used when the file could not be mapped
+  std::vector<char> buffer;
+
+ };
+
+ class ForestFileWriter {
+
+ public:
+
+  ForestFileWriter(const std::string& file_path);
+
+  void write_header(const ForestFileHeader& header);
+
+  void write_u64(std::uint64_t value);
+
+  void write_double(double value);
+
+  void write_blob(const std::vector<unsigned char>& blob);
+
+  void write_vec(const arma::vec& x);
+
+  void write_uvec(const arma::uvec& x);
+
+  // padded to keep the values that follow 8-byte aligned
+  void write_u32_vec(const arma::Col<arma::u32>& x);
+
+  void write_vector(const std::vector<double>& x);
+
+  void write_vector(const std::vector<arma::uword>& x);
+
+  void write_vecs(const std::vector<arma::vec>& x);
+
+  void write_uvecs(const std::vector<arma::uvec>& x);
+
+  void close();
+
+ private:
+
+  // zeros that bring n_bytes up to a multiple of 8
+  void write_padding(std::size_t n_bytes);
+
+  std::ofstream stream;
+  std::string file_path;
+
+ };
+
+ class ForestFileReader {
+
+ public:
+
+  ForestFileReader(std::shared_ptr<MappedFile> file);
+
+  ForestFileHeader read_header();
+
+  std::uint64_t read_u64();
+
+  double read_double();
+
+  std::vector<unsigned char> read_blob();
+
+  // zero copy: the result uses the file's memory, which stays
+  // valid for as long as the MappedFile is alive.
+  arma::vec read_vec_view();
+
+  arma::Col<arma::u32> read_u32_vec_view();
+
+  arma::vec read_vec();
+
+  arma::uvec read_uvec();
+
+  std::vector<double> read_dbl_vector();
+
+  std::vector<arma::uword> read_uword_vector();
+
+  std::vector<arma::vec> read_vec_views();
+
+  std::vector<arma::uvec> read_uvecs();
+
+ private:
+
+  // position of the next n bytes; stops if the file is too short
+  const char* take(std::size_t n_bytes);
+
+  // the length of a vector whose values are value_size bytes each
+  std::uint64_t read_length(std::size_t value_size);
+
+  std::shared_ptr<MappedFile> file;
+  std::size_t position;
+
+ };
+
+ } // namespace aorsf
+
+#endif /* FORESTFILE_H_ */
@@ -1,26 +1,25 @@
 //  Forest.cpp
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "ForestRegression.h"
 #include "TreeRegression.h"
 
 #include <memory>
 
 using namespace arma;
-using namespace Rcpp;
 
 namespace aorsf {
 
 ForestRegression::ForestRegression() { }
 
 void ForestRegression::resize_pred_mat_internal(arma::mat& p,
-                                                arma::uword n){
+                                                arma::uword n) const {
 
  p.zeros(n, 1);
 
  if(verbosity > 3){
-  Rcout << "   -- pred mat size: " << p.n_rows << " rows by ";
-  Rcout << p.n_cols << " columns." << std::endl << std::endl;
+  console() << "   -- pred mat size: " << p.n_rows << " rows by ";
+  console() << p.n_cols << " columns." << std::endl << std::endl;
  }
 
 }
@@ -43,6 +42,7 @@ void ForestRegression::load(
 ) {
 
  this->n_tree    = n_tree;
+ this->n_obs     = n_obs;
  this->pd_type   = pd_type;
  this->pd_x_vals = pd_x_vals;
  this->pd_x_cols = pd_x_cols;
@@ -50,8 +50,8 @@ void ForestRegression::load(
  this->oobag_denom = oobag_denom;
 
  if(verbosity > 2){
-  Rcout << "---- loading forest from input list ----";
-  Rcout << std::endl << std::endl;
+  console() << "---- loading forest from input list ----";
+  console() << std::endl << std::endl;
  }
 
  // Create trees
@@ -87,17 +87,9 @@ void ForestRegression::compute_prediction_accuracy_internal(
 
  if(oobag_eval_type == EVAL_R_FUNCTION){
 
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but Robjects can)
-  Rcpp::Function f_oobag_eval = Rcpp::as<Rcpp::Function>(oobag_R_function);
-  Rcpp::NumericMatrix y_ = Rcpp::wrap(y);
-  Rcpp::NumericVector w_ = Rcpp::wrap(w);
-
   for(uword i = 0; i < oobag_eval.n_cols; ++i){
    vec p = predictions.unsafe_col(i);
-   Rcpp::NumericVector p_ = Rcpp::wrap(p);
-   Rcpp::NumericVector R_result = f_oobag_eval(y_, w_, p_);
-   oobag_eval(row_fill, i) = R_result[0];
+   oobag_eval(row_fill, i) = oobag_eval_function(y, w, p);
   }
 
   return;
@@ -123,12 +115,37 @@ void ForestRegression::compute_prediction_accuracy_internal(
 
 }
 
+void ForestRegression::load_binary_tree(ForestFileReader& reader,
+                                        arma::uvec rows_oobag,
+                                        std::vector<double> cutpoint,
+                                        std::vector<arma::uword> child_left,
+                                        std::vector<arma::vec> coef_values,
+                                        std::vector<arma::uvec> coef_indices,
+                                        std::vector<double> leaf_summary){
+
+ // the order here must match TreeRegression::write_binary_leaves()
+ std::vector<arma::vec> leaf_pred_prob = reader.read_vec_views();
+
+ trees.push_back(
+  std::make_unique<TreeRegression>(n_obs,
+                                   std::move(rows_oobag),
+                                   std::move(cutpoint),
+                                   std::move(child_left),
+                                   std::move(coef_values),
+                                   std::move(coef_indices),
+                                   std::move(leaf_pred_prob),
+                                   std::move(leaf_summary))
+ );
+
+}
+
 // growInternal() in ranger
 void ForestRegression::plant() {
 
  trees.reserve(n_tree);
 
- for (arma::uword i = 0; i < n_tree; ++i) {
+ // loaded trees (see init_append) are already in trees
+ for (arma::uword i = trees.size(); i < n_tree; ++i) {
   trees.push_back(std::make_unique<TreeRegression>());
  }
 
@@ -1,13 +1,12 @@
 //  Forest.cpp
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "ForestSurvival.h"
 #include "TreeSurvival.h"
 
 #include <memory>
 
 using namespace arma;
-using namespace Rcpp;
 
 namespace aorsf {
 
@@ -33,10 +32,12 @@ void ForestSurvival::load(
   std::vector<std::vector<arma::uword>>& forest_child_left,
   std::vector<std::vector<arma::vec>>& forest_coef_values,
   std::vector<std::vector<arma::uvec>>& forest_coef_indices,
-  std::vector<std::vector<arma::vec>>& forest_leaf_pred_indx,
-  std::vector<std::vector<arma::vec>>& forest_leaf_pred_prob,
-  std::vector<std::vector<arma::vec>>& forest_leaf_pred_chaz,
+  std::vector<arma::uvec>& forest_leaf_pred_offset,
+  std::vector<arma::Col<arma::u32>>& forest_leaf_pred_indx,
+  std::vector<arma::vec>& forest_leaf_pred_prob,
+  std::vector<arma::vec>& forest_leaf_pred_chaz,
   std::vector<std::vector<double>>& forest_leaf_summary,
+  arma::vec& unique_event_times,
   arma::vec& oobag_denom,
   PartialDepType pd_type,
   std::vector<arma::mat>& pd_x_vals,
@@ -45,15 +46,17 @@ void ForestSurvival::load(
 ) {
 
  this->n_tree    = n_tree;
+ this->n_obs     = n_obs;
  this->pd_type   = pd_type;
  this->pd_x_vals = pd_x_vals;
  this->pd_x_cols = pd_x_cols;
  this->pd_probs  = pd_probs;
  this->oobag_denom = oobag_denom;
+ this->unique_event_times = unique_event_times;
 
  if(verbosity > 2){
-  Rcout << "---- loading forest from input list ----";
-  Rcout << std::endl << std::endl;
+  console() << "---- loading forest from input list ----";
+  console() << std::endl << std::endl;
  }
 
  // Create trees
@@ -67,10 +70,12 @@ void ForestSurvival::load(
                                   forest_child_left[i],
                                   forest_coef_values[i],
                                   forest_coef_indices[i],
+                                  forest_leaf_pred_offset[i],
                                   forest_leaf_pred_indx[i],
                                   forest_leaf_pred_prob[i],
                                   forest_leaf_pred_chaz[i],
                                   forest_leaf_summary[i],
+                                  &this->unique_event_times,
                                   &pred_horizon)
   );
  }
@@ -83,14 +88,53 @@ void ForestSurvival::load(
 
 }
 
+void ForestSurvival::load_binary_tree(ForestFileReader& reader,
+                                      arma::uvec rows_oobag,
+                                      std::vector<double> cutpoint,
+                                      std::vector<arma::uword> child_left,
+                                      std::vector<arma::vec> coef_values,
+                                      std::vector<arma::uvec> coef_indices,
+                                      std::vector<double> leaf_summary){
+
+ // the order here must match TreeSurvival::write_binary_leaves()
+ arma::uvec           leaf_pred_offset = reader.read_uvec();
+ arma::Col<arma::u32> leaf_pred_indx   = reader.read_u32_vec_view();
+ arma::vec            leaf_pred_prob   = reader.read_vec_view();
+ arma::vec            leaf_pred_chaz   = reader.read_vec_view();
+
+ trees.push_back(
+  std::make_unique<TreeSurvival>(n_obs,
+                                 std::move(rows_oobag),
+                                 std::move(cutpoint),
+                                 std::move(child_left),
+                                 std::move(coef_values),
+                                 std::move(coef_indices),
+                                 std::move(leaf_pred_offset),
+                                 std::move(leaf_pred_indx),
+                                 std::move(leaf_pred_prob),
+                                 std::move(leaf_pred_chaz),
+                                 std::move(leaf_summary),
+                                 &unique_event_times,
+                                 &pred_horizon)
+ );
+
+}
+
 // growInternal() in ranger
 void ForestSurvival::plant() {
 
- this->unique_event_times = find_unique_event_times(data->get_y());
+ // leaves of loaded trees (see init_append) point into the event
+ // times they were loaded with, so new trees use the same ones
+ if(trees.empty()){
+  this->unique_event_times = find_unique_event_times(data->get_y());
+ }
+
+ // ranks are found once here and shared by every tree
+ data->set_y_rank(find_time_ranks(data->get_y().col(0), unique_event_times));
 
  trees.reserve(n_tree);
 
- for (arma::uword i = 0; i < n_tree; ++i) {
+ for (arma::uword i = trees.size(); i < n_tree; ++i) {
   trees.push_back(std::make_unique<TreeSurvival>(leaf_min_events,
                                                  split_min_events,
                                                  &unique_event_times,
@@ -100,15 +144,30 @@ void ForestSurvival::plant() {
 }
 
 void ForestSurvival::resize_pred_mat_internal(arma::mat& p,
-                                              arma::uword n){
+                                              arma::uword n) const {
 
   p.zeros(n, pred_horizon.size());
 
 }
 
-std::vector<std::vector<arma::vec>> ForestSurvival::get_leaf_pred_indx() {
+std::vector<arma::uvec> ForestSurvival::get_leaf_pred_offset() {
+
+ std::vector<arma::uvec> result;
+
+ result.reserve(n_tree);
+
+ for (auto& tree : trees) {
+  auto& temp = dynamic_cast<TreeSurvival&>(*tree);
+  result.push_back(temp.get_leaf_pred_offset());
+ }
+
+ return result;
+
+}
+
+std::vector<arma::Col<arma::u32>> ForestSurvival::get_leaf_pred_indx() {
 
- std::vector<std::vector<arma::vec>> result;
+ std::vector<arma::Col<arma::u32>> result;
 
  result.reserve(n_tree);
 
@@ -121,9 +180,9 @@ std::vector<std::vector<arma::vec>> ForestSurvival::get_leaf_pred_indx() {
 
 }
 
-std::vector<std::vector<arma::vec>> ForestSurvival::get_leaf_pred_prob() {
+std::vector<arma::vec> ForestSurvival::get_leaf_pred_prob() {
 
- std::vector<std::vector<arma::vec>> result;
+ std::vector<arma::vec> result;
 
  result.reserve(n_tree);
 
@@ -136,9 +195,9 @@ std::vector<std::vector<arma::vec>> ForestSurvival::get_leaf_pred_prob() {
 
 }
 
-std::vector<std::vector<arma::vec>> ForestSurvival::get_leaf_pred_chaz() {
+std::vector<arma::vec> ForestSurvival::get_leaf_pred_chaz() {
 
- std::vector<std::vector<arma::vec>> result;
+ std::vector<arma::vec> result;
 
  result.reserve(n_tree);
 
@@ -168,17 +227,9 @@ void ForestSurvival::compute_prediction_accuracy_internal(
 
  if(oobag_eval_type == EVAL_R_FUNCTION){
 
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but Robjects can)
-  Rcpp::Function f_oobag_eval = Rcpp::as<Rcpp::Function>(oobag_R_function);
-  Rcpp::NumericMatrix y_ = Rcpp::wrap(y);
-  Rcpp::NumericVector w_ = Rcpp::wrap(w);
-
   for(uword i = 0; i < oobag_eval.n_cols; ++i){
    vec p = predictions.unsafe_col(i);
-   Rcpp::NumericVector p_ = Rcpp::wrap(p);
-   Rcpp::NumericVector R_result = f_oobag_eval(y_, w_, p_);
-   oobag_eval(row_fill, i) = R_result[0];
+   oobag_eval(row_fill, i) = oobag_eval_function(y, w, p);
   }
   return;
  }
@@ -32,19 +32,22 @@ public:
            std::vector<std::vector<arma::uword>>& forest_child_left,
            std::vector<std::vector<arma::vec>>& forest_coef_values,
            std::vector<std::vector<arma::uvec>>& forest_coef_indices,
-           std::vector<std::vector<arma::vec>>& forest_leaf_pred_indx,
-           std::vector<std::vector<arma::vec>>& forest_leaf_pred_prob,
-           std::vector<std::vector<arma::vec>>& forest_leaf_pred_chaz,
+           std::vector<arma::uvec>& forest_leaf_pred_offset,
+           std::vector<arma::Col<arma::u32>>& forest_leaf_pred_indx,
+           std::vector<arma::vec>& forest_leaf_pred_prob,
+           std::vector<arma::vec>& forest_leaf_pred_chaz,
            std::vector<std::vector<double>>& forest_leaf_summary,
+           arma::vec& unique_event_times,
            arma::vec& oobag_denom,
            PartialDepType pd_type,
            std::vector<arma::mat>& pd_x_vals,
            std::vector<arma::uvec>& pd_x_cols,
            arma::vec& pd_probs);
 
- std::vector<std::vector<arma::vec>> get_leaf_pred_indx();
- std::vector<std::vector<arma::vec>> get_leaf_pred_prob();
- std::vector<std::vector<arma::vec>> get_leaf_pred_chaz();
+ std::vector<arma::uvec> get_leaf_pred_offset();
+ std::vector<arma::Col<arma::u32>> get_leaf_pred_indx();
+ std::vector<arma::vec> get_leaf_pred_prob();
+ std::vector<arma::vec> get_leaf_pred_chaz();
 
  // growInternal() in ranger
  void plant() override;
@@ -56,9 +59,21 @@ public:
    arma::uword row_fill
  ) override;
 
+ TreeType get_tree_type() const override {
+  return(TREE_SURVIVAL);
+ }
+
 protected:
 
- void resize_pred_mat_internal(arma::mat& p, arma::uword n) override;
+ void load_binary_tree(ForestFileReader& reader,
+                       arma::uvec rows_oobag,
+                       std::vector<double> cutpoint,
+                       std::vector<arma::uword> child_left,
+                       std::vector<arma::vec> coef_values,
+                       std::vector<arma::uvec> coef_indices,
+                       std::vector<double> leaf_summary) override;
+
+ void resize_pred_mat_internal(arma::mat& p, arma::uword n) const override;
 
  void resize_oobag_eval() override;
 
@@ -0,0 +1,149 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#include "Runtime.h"
+#include "QuantileSketch.h"
+
+#include <algorithm>
+
+ using namespace arma;
+
+ namespace aorsf {
+
+ QuantileSketch::QuantileSketch() :
+  capacity(DEFAULT_PD_SKETCH_SIZE),
+  n_values(0),
+  sum_values(0){
+
+  levels.resize(1);
+  promote_odd.resize(1, false);
+
+ }
+
+ QuantileSketch::QuantileSketch(arma::uword capacity) :
+  capacity(capacity),
+  n_values(0),
+  sum_values(0){
+
+  // a level needs at least two values to be compacted
+  if(this->capacity < 2) this->capacity = 2;
+
+  levels.resize(1);
+  promote_odd.resize(1, false);
+
+ }
+
+ void QuantileSketch::push(double value){
+
+  levels[0].push_back(value);
+
+  n_values++;
+  sum_values += value;
+
+  if(levels[0].size() >= capacity) compact(0);
+
+ }
+
+ void QuantileSketch::compact(arma::uword level){
+
+  // make room before taking references into levels
+  if(levels.size() == level + 1){
+   levels.emplace_back();
+   promote_odd.push_back(false);
+  }
+
+  std::vector<double>& current = levels[level];
+  std::vector<double>& next = levels[level + 1];
+
+  std::sort(current.begin(), current.end());
+
+  uword offset = promote_odd[level] ? 1 : 0;
+  promote_odd[level] = !promote_odd[level];
+
+  // each pair of values is replaced by one of them with double weight
+  uword n_pairs = current.size() / 2;
+
+  for(uword i = 0; i < n_pairs; ++i){
+   next.push_back(current[2*i + offset]);
+  }
+
+  // if there is an odd value out, it stays on this level
+  if(current.size() % 2 == 1){
+   double odd_value = current.back();
+   current.clear();
+   current.push_back(odd_value);
+  } else {
+   current.clear();
+  }
+
+  if(next.size() >= capacity) compact(level + 1);
+
+ }
+
+ double QuantileSketch::compute_mean(){
+
+  if(n_values == 0) return(datum::nan);
+
+  return(sum_values / n_values);
+
+ }
+
+ double QuantileSketch::find_value_at_rank(
+   std::vector<std::pair<double, double>>& values,
+   double rank
+ ){
+
+  double weight_cumulative = 0;
+
+  for(auto& value : values){
+   weight_cumulative += value.second;
+   if(weight_cumulative > rank) return(value.first);
+  }
+
+  return(values.back().first);
+
+ }
+
+ double QuantileSketch::compute_quantile(double prob){
+
+  if(n_values == 0) return(datum::nan);
+
+  // (value, weight) pairs, sorted by value
+  std::vector<std::pair<double, double>> values;
+
+  for(uword h = 0; h < levels.size(); ++h){
+
+   double weight = std::ldexp(1.0, h);
+
+   for(auto& value : levels[h]){
+    values.push_back(std::make_pair(value, weight));
+   }
+
+  }
+
+  std::sort(values.begin(), values.end());
+
+  // mirrors the arithmetic in R's quantile(type = 7) so that the
+  // result is identical to R when the sketch is still exact
+  double index = 1 + (n_values - 1) * prob;
+  double lo = std::floor(index);
+  double h = index - lo;
+
+  double x_lo = find_value_at_rank(values, lo - 1);
+
+  if(h > 0){
+
+   double x_hi = find_value_at_rank(values, lo);
+
+   if(x_hi != x_lo) return((1 - h) * x_lo + h * x_hi);
+
+  }
+
+  return(x_lo);
+
+ }
+
+ } // namespace aorsf
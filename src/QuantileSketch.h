@@ -0,0 +1,68 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#ifndef QUANTILESKETCH_H_
+#define QUANTILESKETCH_H_
+
+#include <armadillo>
+#include "globals.h"
+
+ namespace aorsf {
+
+ // streaming summary of a stream of values
+ //
+ // @description keeps a running mean and a compacting quantile sketch.
+ //   Values are held exactly until `capacity` of them accumulate on a
+ //   level. When a level fills up, it is sorted and every other value
+ //   is promoted to the next level with twice the weight. The result
+ //   is O(capacity * log(n / capacity)) memory for n values, and
+ //   quantiles are exact (matching R's type 7 quantiles) as long as
+ //   n < capacity.
+ //
+ class QuantileSketch {
+
+ public:
+
+  QuantileSketch();
+
+  QuantileSketch(arma::uword capacity);
+
+  void push(double value);
+
+  double compute_mean();
+
+  double compute_quantile(double prob);
+
+  arma::uword get_n_values(){
+   return(n_values);
+  }
+
+ private:
+
+  void compact(arma::uword level);
+
+  // value at a zero-based rank, accounting for weights
+  double find_value_at_rank(std::vector<std::pair<double, double>>& values,
+                            double rank);
+
+  arma::uword capacity;
+  arma::uword n_values;
+  double sum_values;
+
+  // levels[h] holds values that each stand in for 2^h pushed values
+  std::vector<std::vector<double>> levels;
+
+  // alternates which half of a level is promoted when it is compacted
+  std::vector<bool> promote_odd;
+
+ };
+
+ // sketches[k][j][o] summarizes output o of item j in spec k
+ typedef std::vector<std::vector<std::vector<QuantileSketch>>> PartialDepSketch;
+
+ } // namespace aorsf
+
+#endif /* QUANTILESKETCH_H_ */
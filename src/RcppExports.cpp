@@ -182,14 +182,15 @@ BEGIN_RCPP
 END_RCPP
 }
 // sprout_node_survival_exported
-List sprout_node_survival_exported(arma::mat& y, arma::vec& w);
-RcppExport SEXP _aorsf_sprout_node_survival_exported(SEXP ySEXP, SEXP wSEXP) {
+List sprout_node_survival_exported(arma::mat& y, arma::vec& w, arma::uword node_id);
+RcppExport SEXP _aorsf_sprout_node_survival_exported(SEXP ySEXP, SEXP wSEXP, SEXP node_idSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< arma::mat& >::type y(ySEXP);
     Rcpp::traits::input_parameter< arma::vec& >::type w(wSEXP);
-    rcpp_result_gen = Rcpp::wrap(sprout_node_survival_exported(y, w));
+    Rcpp::traits::input_parameter< arma::uword >::type node_id(node_idSEXP);
+    rcpp_result_gen = Rcpp::wrap(sprout_node_survival_exported(y, w, node_id));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -205,6 +206,18 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// group_rows_by_leaf_exported
+List group_rows_by_leaf_exported(arma::uvec& leaves, arma::uword n_nodes);
+RcppExport SEXP _aorsf_group_rows_by_leaf_exported(SEXP leavesSEXP, SEXP n_nodesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::uvec& >::type leaves(leavesSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type n_nodes(n_nodesSEXP);
+    rcpp_result_gen = Rcpp::wrap(group_rows_by_leaf_exported(leaves, n_nodes));
+    return rcpp_result_gen;
+END_RCPP
+}
 // x_submat_mult_beta_exported
 arma::vec x_submat_mult_beta_exported(arma::mat& x, arma::mat& y, arma::vec& w, arma::uvec& x_rows, arma::uvec& x_cols, arma::vec& beta);
 RcppExport SEXP _aorsf_x_submat_mult_beta_exported(SEXP xSEXP, SEXP ySEXP, SEXP wSEXP, SEXP x_rowsSEXP, SEXP x_colsSEXP, SEXP betaSEXP) {
@@ -289,8 +302,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // orsf_cpp
-List orsf_cpp(arma::mat& x, arma::mat& y, arma::vec& w, arma::uword tree_type_R, Rcpp::IntegerVector& tree_seeds, Rcpp::List& loaded_forest, Rcpp::RObject lincomb_R_function, Rcpp::RObject oobag_R_function, arma::uword n_tree, arma::uword mtry, bool sample_with_replacement, double sample_fraction, arma::uword vi_type_R, double vi_max_pvalue, double leaf_min_events, double leaf_min_obs, arma::uword split_rule_R, double split_min_events, double split_min_obs, double split_min_stat, arma::uword split_max_cuts, arma::uword split_max_retry, arma::uword lincomb_type_R, double lincomb_eps, arma::uword lincomb_iter_max, bool lincomb_scale, double lincomb_alpha, arma::uword lincomb_df_target, arma::uword lincomb_ties_method, bool pred_mode, arma::uword pred_type_R, arma::vec pred_horizon, bool pred_aggregate, bool oobag, arma::uword oobag_eval_type_R, arma::uword oobag_eval_every, int pd_type_R, std::vector<arma::mat>& pd_x_vals, std::vector<arma::uvec>& pd_x_cols, arma::vec& pd_probs, unsigned int n_thread, bool write_forest, bool run_forest, int verbosity);
-RcppExport SEXP _aorsf_orsf_cpp(SEXP xSEXP, SEXP ySEXP, SEXP wSEXP, SEXP tree_type_RSEXP, SEXP tree_seedsSEXP, SEXP loaded_forestSEXP, SEXP lincomb_R_functionSEXP, SEXP oobag_R_functionSEXP, SEXP n_treeSEXP, SEXP mtrySEXP, SEXP sample_with_replacementSEXP, SEXP sample_fractionSEXP, SEXP vi_type_RSEXP, SEXP vi_max_pvalueSEXP, SEXP leaf_min_eventsSEXP, SEXP leaf_min_obsSEXP, SEXP split_rule_RSEXP, SEXP split_min_eventsSEXP, SEXP split_min_obsSEXP, SEXP split_min_statSEXP, SEXP split_max_cutsSEXP, SEXP split_max_retrySEXP, SEXP lincomb_type_RSEXP, SEXP lincomb_epsSEXP, SEXP lincomb_iter_maxSEXP, SEXP lincomb_scaleSEXP, SEXP lincomb_alphaSEXP, SEXP lincomb_df_targetSEXP, SEXP lincomb_ties_methodSEXP, SEXP pred_modeSEXP, SEXP pred_type_RSEXP, SEXP pred_horizonSEXP, SEXP pred_aggregateSEXP, SEXP oobagSEXP, SEXP oobag_eval_type_RSEXP, SEXP oobag_eval_everySEXP, SEXP pd_type_RSEXP, SEXP pd_x_valsSEXP, SEXP pd_x_colsSEXP, SEXP pd_probsSEXP, SEXP n_threadSEXP, SEXP write_forestSEXP, SEXP run_forestSEXP, SEXP verbositySEXP) {
+List orsf_cpp(arma::mat& x, arma::mat& y, arma::vec& w, arma::uword tree_type_R, Rcpp::IntegerVector& tree_seeds, Rcpp::List& loaded_forest, Rcpp::RObject lincomb_R_function, Rcpp::RObject oobag_R_function, arma::uword n_tree, arma::uword mtry, bool sample_with_replacement, double sample_fraction, arma::uword vi_type_R, double vi_max_pvalue, double leaf_min_events, double leaf_min_obs, arma::uword split_rule_R, double split_min_events, double split_min_obs, double split_min_stat, arma::uword split_max_cuts, arma::uword split_max_retry, arma::uword lincomb_type_R, double lincomb_eps, arma::uword lincomb_iter_max, bool lincomb_scale, double lincomb_alpha, arma::uword lincomb_df_target, arma::uword lincomb_ties_method, bool pred_mode, arma::uword pred_type_R, arma::vec pred_horizon, bool pred_aggregate, bool oobag, arma::uword oobag_eval_type_R, arma::uword oobag_eval_every, int pd_type_R, std::vector<arma::mat>& pd_x_vals, std::vector<arma::uvec>& pd_x_cols, arma::vec& pd_probs, unsigned int n_thread, bool write_forest, bool run_forest, int verbosity, std::string trace_file, double max_memory, bool append_forest, double oobag_stop_tolerance, arma::uword oobag_stop_window, double max_seconds, std::string checkpoint_file, arma::uword checkpoint_every);
+RcppExport SEXP _aorsf_orsf_cpp(SEXP xSEXP, SEXP ySEXP, SEXP wSEXP, SEXP tree_type_RSEXP, SEXP tree_seedsSEXP, SEXP loaded_forestSEXP, SEXP lincomb_R_functionSEXP, SEXP oobag_R_functionSEXP, SEXP n_treeSEXP, SEXP mtrySEXP, SEXP sample_with_replacementSEXP, SEXP sample_fractionSEXP, SEXP vi_type_RSEXP, SEXP vi_max_pvalueSEXP, SEXP leaf_min_eventsSEXP, SEXP leaf_min_obsSEXP, SEXP split_rule_RSEXP, SEXP split_min_eventsSEXP, SEXP split_min_obsSEXP, SEXP split_min_statSEXP, SEXP split_max_cutsSEXP, SEXP split_max_retrySEXP, SEXP lincomb_type_RSEXP, SEXP lincomb_epsSEXP, SEXP lincomb_iter_maxSEXP, SEXP lincomb_scaleSEXP, SEXP lincomb_alphaSEXP, SEXP lincomb_df_targetSEXP, SEXP lincomb_ties_methodSEXP, SEXP pred_modeSEXP, SEXP pred_type_RSEXP, SEXP pred_horizonSEXP, SEXP pred_aggregateSEXP, SEXP oobagSEXP, SEXP oobag_eval_type_RSEXP, SEXP oobag_eval_everySEXP, SEXP pd_type_RSEXP, SEXP pd_x_valsSEXP, SEXP pd_x_colsSEXP, SEXP pd_probsSEXP, SEXP n_threadSEXP, SEXP write_forestSEXP, SEXP run_forestSEXP, SEXP verbositySEXP, SEXP trace_fileSEXP, SEXP max_memorySEXP, SEXP append_forestSEXP, SEXP oobag_stop_toleranceSEXP, SEXP oobag_stop_windowSEXP, SEXP max_secondsSEXP, SEXP checkpoint_fileSEXP, SEXP checkpoint_everySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -338,7 +351,94 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type write_forest(write_forestSEXP);
     Rcpp::traits::input_parameter< bool >::type run_forest(run_forestSEXP);
     Rcpp::traits::input_parameter< int >::type verbosity(verbositySEXP);
-    rcpp_result_gen = Rcpp::wrap(orsf_cpp(x, y, w, tree_type_R, tree_seeds, loaded_forest, lincomb_R_function, oobag_R_function, n_tree, mtry, sample_with_replacement, sample_fraction, vi_type_R, vi_max_pvalue, leaf_min_events, leaf_min_obs, split_rule_R, split_min_events, split_min_obs, split_min_stat, split_max_cuts, split_max_retry, lincomb_type_R, lincomb_eps, lincomb_iter_max, lincomb_scale, lincomb_alpha, lincomb_df_target, lincomb_ties_method, pred_mode, pred_type_R, pred_horizon, pred_aggregate, oobag, oobag_eval_type_R, oobag_eval_every, pd_type_R, pd_x_vals, pd_x_cols, pd_probs, n_thread, write_forest, run_forest, verbosity));
+    Rcpp::traits::input_parameter< std::string >::type trace_file(trace_fileSEXP);
+    Rcpp::traits::input_parameter< double >::type max_memory(max_memorySEXP);
+    Rcpp::traits::input_parameter< bool >::type append_forest(append_forestSEXP);
+    Rcpp::traits::input_parameter< double >::type oobag_stop_tolerance(oobag_stop_toleranceSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type oobag_stop_window(oobag_stop_windowSEXP);
+    Rcpp::traits::input_parameter< double >::type max_seconds(max_secondsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type checkpoint_file(checkpoint_fileSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type checkpoint_every(checkpoint_everySEXP);
+    rcpp_result_gen = Rcpp::wrap(orsf_cpp(x, y, w, tree_type_R, tree_seeds, loaded_forest, lincomb_R_function, oobag_R_function, n_tree, mtry, sample_with_replacement, sample_fraction, vi_type_R, vi_max_pvalue, leaf_min_events, leaf_min_obs, split_rule_R, split_min_events, split_min_obs, split_min_stat, split_max_cuts, split_max_retry, lincomb_type_R, lincomb_eps, lincomb_iter_max, lincomb_scale, lincomb_alpha, lincomb_df_target, lincomb_ties_method, pred_mode, pred_type_R, pred_horizon, pred_aggregate, oobag, oobag_eval_type_R, oobag_eval_every, pd_type_R, pd_x_vals, pd_x_cols, pd_probs, n_thread, write_forest, run_forest, verbosity, trace_file, max_memory, append_forest, oobag_stop_tolerance, oobag_stop_window, max_seconds, checkpoint_file, checkpoint_every));
+    return rcpp_result_gen;
+END_RCPP
+}
+// orsf_scorer_cpp
+SEXP orsf_scorer_cpp(Rcpp::List& loaded_forest, arma::uword tree_type_R, arma::uword n_class, arma::uword pred_type_R, arma::vec pred_horizon);
+RcppExport SEXP _aorsf_orsf_scorer_cpp(SEXP loaded_forestSEXP, SEXP tree_type_RSEXP, SEXP n_classSEXP, SEXP pred_type_RSEXP, SEXP pred_horizonSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List& >::type loaded_forest(loaded_forestSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type tree_type_R(tree_type_RSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type n_class(n_classSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type pred_type_R(pred_type_RSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type pred_horizon(pred_horizonSEXP);
+    rcpp_result_gen = Rcpp::wrap(orsf_scorer_cpp(loaded_forest, tree_type_R, n_class, pred_type_R, pred_horizon));
+    return rcpp_result_gen;
+END_RCPP
+}
+// orsf_write_binary_cpp
+void orsf_write_binary_cpp(Rcpp::List& loaded_forest, arma::uword tree_type_R, arma::uword n_class, std::string file_path, Rcpp::RawVector metadata);
+RcppExport SEXP _aorsf_orsf_write_binary_cpp(SEXP loaded_forestSEXP, SEXP tree_type_RSEXP, SEXP n_classSEXP, SEXP file_pathSEXP, SEXP metadataSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List& >::type loaded_forest(loaded_forestSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type tree_type_R(tree_type_RSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type n_class(n_classSEXP);
+    Rcpp::traits::input_parameter< std::string >::type file_path(file_pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::RawVector >::type metadata(metadataSEXP);
+    orsf_write_binary_cpp(loaded_forest, tree_type_R, n_class, file_path, metadata);
+    return R_NilValue;
+END_RCPP
+}
+// orsf_read_binary_metadata_cpp
+Rcpp::RawVector orsf_read_binary_metadata_cpp(std::string file_path);
+RcppExport SEXP _aorsf_orsf_read_binary_metadata_cpp(SEXP file_pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file_path(file_pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(orsf_read_binary_metadata_cpp(file_path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// orsf_scorer_binary_cpp
+SEXP orsf_scorer_binary_cpp(std::string file_path, arma::uword pred_type_R, arma::vec pred_horizon);
+RcppExport SEXP _aorsf_orsf_scorer_binary_cpp(SEXP file_pathSEXP, SEXP pred_type_RSEXP, SEXP pred_horizonSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file_path(file_pathSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type pred_type_R(pred_type_RSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type pred_horizon(pred_horizonSEXP);
+    rcpp_result_gen = Rcpp::wrap(orsf_scorer_binary_cpp(file_path, pred_type_R, pred_horizon));
+    return rcpp_result_gen;
+END_RCPP
+}
+// orsf_scorer_predict_cpp
+arma::mat orsf_scorer_predict_cpp(SEXP scorer, arma::mat& x);
+RcppExport SEXP _aorsf_orsf_scorer_predict_cpp(SEXP scorerSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type scorer(scorerSEXP);
+    Rcpp::traits::input_parameter< arma::mat& >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(orsf_scorer_predict_cpp(scorer, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scorer_predict_concurrent_exported
+List scorer_predict_concurrent_exported(SEXP scorer, arma::mat& x, arma::uword n_thread, arma::uword n_repeat);
+RcppExport SEXP _aorsf_scorer_predict_concurrent_exported(SEXP scorerSEXP, SEXP xSEXP, SEXP n_threadSEXP, SEXP n_repeatSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type scorer(scorerSEXP);
+    Rcpp::traits::input_parameter< arma::mat& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type n_thread(n_threadSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type n_repeat(n_repeatSEXP);
+    rcpp_result_gen = Rcpp::wrap(scorer_predict_concurrent_exported(scorer, x, n_thread, n_repeat));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -356,15 +456,22 @@ static const R_CallMethodDef CallEntries[] = {
     {"_aorsf_compute_var_reduction_exported", (DL_FUNC) &_aorsf_compute_var_reduction_exported, 3},
     {"_aorsf_is_col_splittable_exported", (DL_FUNC) &_aorsf_is_col_splittable_exported, 4},
     {"_aorsf_find_cuts_survival_exported", (DL_FUNC) &_aorsf_find_cuts_survival_exported, 6},
-    {"_aorsf_sprout_node_survival_exported", (DL_FUNC) &_aorsf_sprout_node_survival_exported, 2},
+    {"_aorsf_sprout_node_survival_exported", (DL_FUNC) &_aorsf_sprout_node_survival_exported, 3},
     {"_aorsf_find_rows_inbag_exported", (DL_FUNC) &_aorsf_find_rows_inbag_exported, 2},
+    {"_aorsf_group_rows_by_leaf_exported", (DL_FUNC) &_aorsf_group_rows_by_leaf_exported, 2},
     {"_aorsf_x_submat_mult_beta_exported", (DL_FUNC) &_aorsf_x_submat_mult_beta_exported, 6},
     {"_aorsf_x_submat_mult_beta_pd_exported", (DL_FUNC) &_aorsf_x_submat_mult_beta_pd_exported, 8},
     {"_aorsf_scale_x_exported", (DL_FUNC) &_aorsf_scale_x_exported, 2},
     {"_aorsf_cph_scale", (DL_FUNC) &_aorsf_cph_scale, 2},
     {"_aorsf_expand_y_clsf", (DL_FUNC) &_aorsf_expand_y_clsf, 2},
     {"_aorsf_compute_mse_exported", (DL_FUNC) &_aorsf_compute_mse_exported, 3},
-    {"_aorsf_orsf_cpp", (DL_FUNC) &_aorsf_orsf_cpp, 44},
+    {"_aorsf_orsf_cpp", (DL_FUNC) &_aorsf_orsf_cpp, 52},
+    {"_aorsf_orsf_scorer_cpp", (DL_FUNC) &_aorsf_orsf_scorer_cpp, 5},
+    {"_aorsf_orsf_write_binary_cpp", (DL_FUNC) &_aorsf_orsf_write_binary_cpp, 5},
+    {"_aorsf_orsf_read_binary_metadata_cpp", (DL_FUNC) &_aorsf_orsf_read_binary_metadata_cpp, 1},
+    {"_aorsf_orsf_scorer_binary_cpp", (DL_FUNC) &_aorsf_orsf_scorer_binary_cpp, 3},
+    {"_aorsf_orsf_scorer_predict_cpp", (DL_FUNC) &_aorsf_orsf_scorer_predict_cpp, 2},
+    {"_aorsf_scorer_predict_concurrent_exported", (DL_FUNC) &_aorsf_scorer_predict_concurrent_exported, 4},
     {NULL, NULL, 0}
 };
 
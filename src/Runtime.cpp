@@ -0,0 +1,234 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#include "Runtime.h"
+
+#ifdef AORSF_STANDALONE
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#endif
+
+ namespace aorsf {
+
+#ifndef AORSF_STANDALONE
+
+ std::ostream& console(){
+  return(Rcpp::Rcout);
+ }
+
+ void stop(const std::string& message){
+  Rcpp::stop(message);
+ }
+
+ void checkUserInterrupt(){
+  Rcpp::checkUserInterrupt();
+ }
+
+ static void chkIntFn(void *dummy) {
+  R_CheckUserInterrupt();
+ }
+
+ bool checkInterrupt() {
+  return (R_ToplevelExec(chkIntFn, NULL) == FALSE);
+ }
+
+ double pchisq(double x, double df, bool lower_tail){
+  return(R::pchisq(x, df, lower_tail, false));
+ }
+
+ double pt(double x, double df, bool lower_tail){
+  return(R::pt(x, df, lower_tail, false));
+ }
+
+#else
+
+ static std::ostream* console_stream = &std::cout;
+
+ static std::atomic<bool> interrupt_requested(false);
+
+ void set_console(std::ostream* stream){
+  console_stream = stream;
+ }
+
+ std::ostream& console(){
+  return(*console_stream);
+ }
+
+ void stop(const std::string& message){
+  throw std::runtime_error(message);
+ }
+
+ void request_interrupt(){
+  interrupt_requested = true;
+ }
+
+ void checkUserInterrupt(){
+  if(interrupt_requested.exchange(false)){
+   throw std::runtime_error("User interrupt.");
+  }
+ }
+
+ bool checkInterrupt(){
+  return(interrupt_requested.exchange(false));
+ }
+
+ // continued fractions below use the modified Lentz method
+ const double LENTZ_TINY = 1e-300;
+ const double LENTZ_EPS = 1e-15;
+ const int LENTZ_ITER_MAX = 1000;
+
+ // regularized lower incomplete gamma function P(a, x), for x < a + 1
+ static double gamma_p_series(double a, double x){
+
+  double term = 1 / a, sum = term;
+
+  for(int n = 1; n < LENTZ_ITER_MAX; ++n){
+   term *= x / (a + n);
+   sum += term;
+   if(std::abs(term) < std::abs(sum) * LENTZ_EPS) break;
+  }
+
+  return(sum * std::exp(-x + a * std::log(x) - std::lgamma(a)));
+
+ }
+
+ // regularized upper incomplete gamma function Q(a, x), for x >= a + 1
+ static double gamma_q_fraction(double a, double x){
+
+  double b = x + 1 - a, c = 1 / LENTZ_TINY, d = 1 / b, h = d;
+
+  for(int i = 1; i < LENTZ_ITER_MAX; ++i){
+
+   double an = -i * (i - a);
+
+   b += 2;
+
+   d = an * d + b;
+   if(std::abs(d) < LENTZ_TINY) d = LENTZ_TINY;
+
+   c = b + an / c;
+   if(std::abs(c) < LENTZ_TINY) c = LENTZ_TINY;
+
+   d = 1 / d;
+
+   double delta = d * c;
+
+   h *= delta;
+
+   if(std::abs(delta - 1) < LENTZ_EPS) break;
+
+  }
+
+  return(h * std::exp(-x + a * std::log(x) - std::lgamma(a)));
+
+ }
+
+ static double beta_fraction(double a, double b, double x){
+
+  double qab = a + b, qap = a + 1, qam = a - 1;
+
+  double c = 1, d = 1 - qab * x / qap;
+
+  if(std::abs(d) < LENTZ_TINY) d = LENTZ_TINY;
+
+  d = 1 / d;
+
+  double h = d;
+
+  for(int m = 1; m < LENTZ_ITER_MAX; ++m){
+
+   int m2 = 2 * m;
+
+   // even step
+   double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+
+   d = 1 + aa * d;
+   if(std::abs(d) < LENTZ_TINY) d = LENTZ_TINY;
+
+   c = 1 + aa / c;
+   if(std::abs(c) < LENTZ_TINY) c = LENTZ_TINY;
+
+   d = 1 / d;
+   h *= d * c;
+
+   // odd step
+   aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+
+   d = 1 + aa * d;
+   if(std::abs(d) < LENTZ_TINY) d = LENTZ_TINY;
+
+   c = 1 + aa / c;
+   if(std::abs(c) < LENTZ_TINY) c = LENTZ_TINY;
+
+   d = 1 / d;
+
+   double delta = d * c;
+
+   h *= delta;
+
+   if(std::abs(delta - 1) < LENTZ_EPS) break;
+
+  }
+
+  return(h);
+
+ }
+
+ // regularized incomplete beta function I_x(a, b)
+ static double beta_regularized(double a, double b, double x){
+
+  if(x <= 0) return(0);
+  if(x >= 1) return(1);
+
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+                          std::lgamma(b) + a * std::log(x) +
+                          b * std::log1p(-x));
+
+  // the fraction converges quickly on this side of the mean
+  if(x < (a + 1) / (a + b + 2)) return(front * beta_fraction(a, b, x) / a);
+
+  return(1 - front * beta_fraction(b, a, 1 - x) / b);
+
+ }
+
+ double pchisq(double x, double df, bool lower_tail){
+
+  if(std::isnan(x)) return(x);
+
+  if(x <= 0) return(lower_tail ? 0 : 1);
+
+  double a = df / 2, z = x / 2, lower, upper;
+
+  if(z < a + 1){
+   lower = gamma_p_series(a, z);
+   upper = 1 - lower;
+  } else {
+   upper = gamma_q_fraction(a, z);
+   lower = 1 - upper;
+  }
+
+  return(lower_tail ? lower : upper);
+
+ }
+
+ double pt(double x, double df, bool lower_tail){
+
+  if(std::isnan(x)) return(x);
+
+  // probability that |T| > |x|, halved
+  double tail = 0.5 * beta_regularized(df / 2, 0.5, df / (df + x * x));
+
+  double lower = x > 0 ? 1 - tail : tail;
+
+  return(lower_tail ? lower : 1 - lower);
+
+ }
+
+#endif
+
+ } // namespace aorsf
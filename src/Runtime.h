@@ -0,0 +1,82 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#ifndef RUNTIME_H_
+#define RUNTIME_H_
+
+// R's headers must come before armadillo's so that RcppArmadillo can
+// configure armadillo (e.g., to print with Rcpp::Rcout)
+#ifndef AORSF_STANDALONE
+#include <RcppArmadillo.h>
+#endif
+
+#include <armadillo>
+#include <functional>
+#include <ostream>
+#include <string>
+
+ namespace aorsf {
+
+ // services the engine needs from the program that runs it
+ //
+ // @description the engine (Forest, Tree, and the routines they use)
+ //   only calls R through these. In the R package, they forward to
+ //   Rcpp and R's API. When AORSF_STANDALONE is defined, e.g., in the
+ //   aorsf_core target of src/CMakeLists.txt, they use the standard
+ //   library instead and the engine can be linked without R.
+
+ // stream for progress and debugging output
+ std::ostream& console();
+
+ // stops the current computation with an error message. Only call
+ // this from the main thread.
+ [[noreturn]] void stop(const std::string& message);
+
+ // stops with "User interrupt." if the user asked to interrupt.
+ // Only call this from the main thread.
+ void checkUserInterrupt();
+
+ // true if the user asked to interrupt. Call this from the main
+ // thread while worker threads run.
+ bool checkInterrupt();
+
+ // distribution functions with the same arguments as R::pchisq()
+ // and R::pt() (log_p is not supported)
+ double pchisq(double x, double df, bool lower_tail);
+
+ double pt(double x, double df, bool lower_tail);
+
+ // user supplied functions
+ //
+ // @description LincombFunction finds the coefficients of a linear
+ //   combination of x for one node, with one row per column of x.
+ //   EvalFunction measures the accuracy of predictions p for outcome
+ //   y with weights w. Empty functions are never called.
+
+ typedef std::function<arma::mat(const arma::mat& x,
+                                 const arma::mat& y,
+                                 const arma::vec& w)> LincombFunction;
+
+ typedef std::function<double(const arma::mat& y,
+                              const arma::vec& w,
+                              const arma::vec& p)> EvalFunction;
+
+ #ifdef AORSF_STANDALONE
+
+ // programs that embed the engine can redirect output (by default,
+ // it goes to std::cout) and ask running forests to stop. Interrupts
+ // are checked where R would check them, and a pending request is
+ // cleared when it stops a forest.
+
+ void set_console(std::ostream* stream);
+
+ void request_interrupt();
+
+ #endif
+
+ } // namespace aorsf
+
+#endif /* RUNTIME_H_ */
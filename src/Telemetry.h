@@ -0,0 +1,202 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <armadillo>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+ namespace aorsf {
+
+ // counters and timers collected while a tree grows
+ //
+ // @description each tree owns its telemetry, so threads that grow
+ //   different trees never write to the same counters and no locks
+ //   are needed. The forest adds them up after growing. Timers are
+ //   in seconds and are summed over nodes, so the totals over all
+ //   trees are CPU time rather than wall time when n_thread > 1.
+ //
+ struct TreeTelemetry {
+
+  double time_sample_rows   = 0;
+  // finding the rows in a node and checking if it can be split
+  double time_node_prep     = 0;
+  double time_lincomb       = 0;
+  double time_sort_index    = 0;
+  double time_find_all_cuts = 0;
+  double time_find_best_cut = 0;
+  double time_sprout_leaf   = 0;
+  double time_routing       = 0;
+
+  // glm fits and their newton raphson / IRLS iterations
+  arma::uword n_lincomb_fits = 0;
+  arma::uword n_lincomb_iter = 0;
+
+  // attempts to split a node beyond the first one
+  arma::uword n_split_retry = 0;
+
+  arma::uword n_nodes = 0;
+  arma::uword n_leaves = 0;
+  arma::uword max_depth = 0;
+
+  // sum of the number of rows in each node that was visited
+  arma::uword n_rows_touched = 0;
+
+  void add(const TreeTelemetry& other){
+
+   time_sample_rows   += other.time_sample_rows;
+   time_node_prep     += other.time_node_prep;
+   time_lincomb       += other.time_lincomb;
+   time_sort_index    += other.time_sort_index;
+   time_find_all_cuts += other.time_find_all_cuts;
+   time_find_best_cut += other.time_find_best_cut;
+   time_sprout_leaf   += other.time_sprout_leaf;
+   time_routing       += other.time_routing;
+
+   n_lincomb_fits += other.n_lincomb_fits;
+   n_lincomb_iter += other.n_lincomb_iter;
+   n_split_retry  += other.n_split_retry;
+   n_nodes        += other.n_nodes;
+   n_leaves       += other.n_leaves;
+   n_rows_touched += other.n_rows_touched;
+
+   if(other.max_depth > max_depth) max_depth = other.max_depth;
+
+  }
+
+ };
+
+ // wall time (seconds) and peak accounted memory (bytes, see
+ // MemoryTracker) of each forest level phase
+ struct ForestTelemetry {
+
+  double time_grow       = 0;
+  double time_predict    = 0;
+  double time_importance = 0;
+  double time_dependence = 0;
+
+  double peak_grow       = 0;
+  double peak_predict    = 0;
+  double peak_importance = 0;
+  double peak_dependence = 0;
+
+  // threads that grew trees (fewer than n_thread if they would not
+  // all fit in max_memory) and the working bytes each one reserved
+  arma::uword n_thread_grow = 0;
+  double bytes_grow_thread  = 0;
+
+ };
+
+ // bytes held by the parts of a trained forest
+ struct ModelBytes {
+
+  // cutpoints and child_left
+  double nodes        = 0;
+  // coef_values and coef_indices
+  double coefficients = 0;
+  // leaf_summary and the leaf tables of the tree type
+  double leaves       = 0;
+  double oobag_rows   = 0;
+
+  void add(const ModelBytes& other){
+   nodes        += other.nodes;
+   coefficients += other.coefficients;
+   leaves       += other.leaves;
+   oobag_rows   += other.oobag_rows;
+  }
+
+  double total() const {
+   return(nodes + coefficients + leaves + oobag_rows);
+  }
+
+ };
+
+ // running total of the large blocks of memory the engine allocates
+ //
+ // @description the engine does not see every allocation, so this
+ //   accounts for the large ones that scale with the data: copies
+ //   of inbag and oobag data, node and leaf reservations in trees,
+ //   and prediction and partial dependence results (including the
+ //   copies held by each thread). Threads may add and remove bytes
+ //   at the same time. The peak is the highest total seen since the
+ //   last call to reset_peak().
+ //
+ //   A limit of 0 means there is no limit. The tracker does not
+ //   enforce the limit; callers use fits() to pick a strategy
+ //   before they allocate.
+ //
+ class MemoryTracker {
+
+ public:
+
+  MemoryTracker() : current(0), peak(0), limit(0) { }
+
+  void set_limit(double bytes){
+   limit = bytes;
+  }
+
+  double get_limit() const {
+   return(limit);
+  }
+
+  // true if bytes more can be allocated without passing the limit
+  bool fits(double bytes) const {
+   return(limit <= 0 || (double) current.load() + bytes <= limit);
+  }
+
+  void add(double bytes){
+
+   std::uint64_t total = current.fetch_add((std::uint64_t) bytes) +
+    (std::uint64_t) bytes;
+
+   std::uint64_t peak_seen = peak.load();
+
+   while(total > peak_seen && !peak.compare_exchange_weak(peak_seen, total));
+
+  }
+
+  void remove(double bytes){
+   current.fetch_sub((std::uint64_t) bytes);
+  }
+
+  double get_current() const {
+   return((double) current.load());
+  }
+
+  double get_peak() const {
+   return((double) peak.load());
+  }
+
+  void reset_peak(){
+   peak.store(current.load());
+  }
+
+ private:
+
+  std::atomic<std::uint64_t> current;
+  std::atomic<std::uint64_t> peak;
+
+  double limit;
+
+ };
+
+ typedef std::chrono::steady_clock::time_point TimePoint;
+
+ inline TimePoint time_now(){
+  return(std::chrono::steady_clock::now());
+ }
+
+ inline double seconds_since(TimePoint start){
+  std::chrono::duration<double> elapsed = time_now() - start;
+  return(elapsed.count());
+ }
+
+ } // namespace aorsf
+
+#endif /* TELEMETRY_H_ */
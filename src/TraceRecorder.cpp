@@ -0,0 +1,102 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#include "Runtime.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+ using namespace arma;
+
+ namespace aorsf {
+
+ TraceRecorder::TraceRecorder(uint n_thread, arma::uword capacity) :
+  origin(time_now()),
+  capacity(capacity),
+  n_thread(n_thread){
+
+  // the last buffer belongs to the thread that runs the forest
+  events.resize(n_thread + 1);
+  n_recorded.assign(n_thread + 1, 0);
+
+  for(auto& events_thread : events) events_thread.resize(capacity);
+
+ }
+
+ void TraceRecorder::record(uint thread_idx,
+                            const char* name,
+                            arma::uword id,
+                            TimePoint start){
+
+  std::chrono::duration<double, std::micro> since_origin = start - origin;
+
+  TraceEvent& event = events[thread_idx][n_recorded[thread_idx] % capacity];
+
+  event.name = name;
+  event.id = id;
+  event.start = since_origin.count();
+  event.duration = seconds_since(start) * 1e6;
+
+  n_recorded[thread_idx]++;
+
+ }
+
+ void TraceRecorder::write_json(const std::string& file_path) const {
+
+  std::ofstream stream(file_path, std::ios::trunc);
+
+  if(!stream) stop("unable to open " + file_path + " for writing");
+
+  // timestamps are in microseconds
+  stream << std::fixed << std::setprecision(3);
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first = true;
+
+  for(uint i = 0; i <= n_thread; ++i){
+
+   if(!first) stream << ",";
+   first = false;
+
+   std::string thread_name = (i == n_thread) ?
+    "main" : "worker " + std::to_string(i);
+
+   stream << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,";
+   stream << "\"tid\":" << i << ",";
+   stream << "\"args\":{\"name\":\"" << thread_name << "\"}}";
+
+   // oldest event first; the buffer has wrapped if more
+   // events were recorded than it can hold
+   uword n_kept = std::min(n_recorded[i], capacity);
+   uword oldest = n_recorded[i] - n_kept;
+
+   for(uword j = oldest; j < n_recorded[i]; ++j){
+
+    const TraceEvent& event = events[i][j % capacity];
+
+    stream << ",\n{\"name\":\"" << event.name << "\",";
+    stream << "\"ph\":\"X\",\"pid\":0,\"tid\":" << i << ",";
+    stream << "\"ts\":" << event.start << ",";
+    stream << "\"dur\":" << event.duration << ",";
+    stream << "\"args\":{\"id\":" << event.id << "}}";
+
+   }
+
+  }
+
+  stream << "\n]}\n";
+
+  stream.close();
+
+  if(stream.fail()) stop("unable to finish writing " + file_path);
+
+ }
+
+ } // namespace aorsf
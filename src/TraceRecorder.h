@@ -0,0 +1,75 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+#ifndef TRACERECORDER_H_
+#define TRACERECORDER_H_
+
+#include <armadillo>
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "Telemetry.h"
+
+ namespace aorsf {
+
+ // one span of work on one thread
+ struct TraceEvent {
+  // a string literal, e.g., "grow tree"
+  const char* name;
+  // index of the tree (or first row) that the span worked on
+  arma::uword id;
+  // microseconds since the recorder was created
+  double start;
+  double duration;
+ };
+
+ // timeline of work done by each thread, for chrome://tracing or
+ // https://ui.perfetto.dev
+ //
+ // @description each thread records into its own ring buffer, so
+ //   recording takes no locks and threads never write to the same
+ //   memory. Buffers hold the last `capacity` events of each thread.
+ //   write_json() reads the buffers and must only be called after
+ //   the threads that record have been joined.
+ //
+ //   Threads are identified by their thread_idx in Forest. Work done
+ //   by the calling thread outside of the workers (e.g., adding up
+ //   results from threads, or running R functions) is recorded with
+ //   thread_idx = n_thread.
+ //
+ class TraceRecorder {
+
+ public:
+
+  TraceRecorder(uint n_thread, arma::uword capacity);
+
+  // add a span that began at start and ends now
+  void record(uint thread_idx,
+              const char* name,
+              arma::uword id,
+              TimePoint start);
+
+  // Chrome trace event format, with one complete ('X') event per span
+  void write_json(const std::string& file_path) const;
+
+ private:
+
+  TimePoint origin;
+
+  arma::uword capacity;
+
+  uint n_thread;
+
+  std::vector<std::vector<TraceEvent>> events;
+
+  // events recorded by each thread, including overwritten ones
+  std::vector<arma::uword> n_recorded;
+
+ };
+
+ } // namespace aorsf
+
+#endif /* TRACERECORDER_H_ */
@@ -4,15 +4,15 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "Tree.h"
 #include "Coxph.h"
 
+#include <algorithm>
 #include <memory>
 #include <random>
 
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
@@ -40,17 +40,16 @@
    lincomb_alpha(DEFAULT_LINCOMB_ALPHA),
    lincomb_df_target(0),
    lincomb_ties_method(DEFAULT_LINCOMB_TIES_METHOD),
-   lincomb_R_function(0),
    verbosity(0){
 
  }
 
- Tree::Tree(arma::uvec& rows_oobag,
-            std::vector<double>& cutpoint,
-            std::vector<arma::uword>& child_left,
-            std::vector<arma::vec>& coef_values,
-            std::vector<arma::uvec>& coef_indices,
-            std::vector<double>& leaf_summary) :
+ Tree::Tree(arma::uvec rows_oobag,
+            std::vector<double> cutpoint,
+            std::vector<arma::uword> child_left,
+            std::vector<arma::vec> coef_values,
+            std::vector<arma::uvec> coef_indices,
+            std::vector<double> leaf_summary) :
  data(0),
  n_cols_total(0),
  n_rows_total(0),
@@ -72,17 +71,16 @@
  lincomb_alpha(DEFAULT_LINCOMB_ALPHA),
  lincomb_df_target(0),
  lincomb_ties_method(DEFAULT_LINCOMB_TIES_METHOD),
- lincomb_R_function(0),
  verbosity(0),
- rows_oobag(rows_oobag),
- cutpoint(cutpoint),
- child_left(child_left),
- coef_values(coef_values),
- coef_indices(coef_indices),
- leaf_summary(leaf_summary){
+ rows_oobag(std::move(rows_oobag)),
+ cutpoint(std::move(cutpoint)),
+ child_left(std::move(child_left)),
+ coef_values(std::move(coef_values)),
+ coef_indices(std::move(coef_indices)),
+ leaf_summary(std::move(leaf_summary)){
 
-  this->max_nodes = cutpoint.size()+1;
-  this->max_leaves = cutpoint.size()+1;
+  this->max_nodes = this->cutpoint.size()+1;
+  this->max_leaves = this->cutpoint.size()+1;
 
  }
 
@@ -110,8 +108,8 @@
                  double lincomb_alpha,
                  arma::uword lincomb_df_target,
                  arma::uword lincomb_ties_method,
-                 RObject lincomb_R_function,
-                 RObject oobag_R_function,
+                 LincombFunction lincomb_function,
+                 EvalFunction oobag_eval_function,
                  EvalType oobag_eval_type,
                  int verbosity){
 
@@ -143,8 +141,8 @@
   this->lincomb_alpha = lincomb_alpha;
   this->lincomb_df_target = lincomb_df_target;
   this->lincomb_ties_method = lincomb_ties_method;
-  this->lincomb_R_function = lincomb_R_function;
-  this->oobag_R_function = oobag_R_function;
+  this->lincomb_function = lincomb_function;
+  this->oobag_eval_function = oobag_eval_function;
   this->oobag_eval_type = oobag_eval_type;
   this->verbosity = verbosity;
 
@@ -332,9 +330,9 @@
   if(verbosity > 4){
    // # nocov start
    mat x_print = x_inbag.rows(rows_node);
-   Rcout << "   -- Column " << j << " was sampled but ";
-   Rcout << "its unique values are " << unique(x_print.col(j));
-   Rcout << std::endl;
+   console() << "   -- Column " << j << " was sampled but ";
+   console() << "its unique values are " << unique(x_print.col(j));
+   console() << std::endl;
    // # nocov end
   }
 
@@ -351,6 +349,7 @@
    rows_node = regspace<uvec>(0, n_rows_inbag-1);
    y_node = y_inbag;
    w_node = w_inbag;
+   prep_node_internal();
    return(true);
 
   }
@@ -360,6 +359,8 @@
   y_node = y_inbag.rows(rows_node);
   w_node = w_inbag(rows_node);
 
+  prep_node_internal();
+
   bool result = is_node_splittable_internal();
 
   return(result);
@@ -405,10 +406,10 @@
 
      if(verbosity > 3){
       // # nocov start
-      Rcout << std::endl;
-      Rcout << "   -- lower cutpoint: " << lincomb(*it) << std::endl;
-      Rcout << "      - n_obs, left node:   " << n_obs   << std::endl;
-      Rcout << std::endl;
+      console() << std::endl;
+      console() << "   -- lower cutpoint: " << lincomb(*it) << std::endl;
+      console() << "      - n_obs, left node:   " << n_obs   << std::endl;
+      console() << std::endl;
       // # nocov end
      }
 
@@ -426,7 +427,7 @@
 
    if(verbosity > 3){
     // # nocov start
-    Rcout << "   -- Could not find a valid cut-point" << std::endl;
+    console() << "   -- Could not find a valid cut-point" << std::endl;
     // # nocov end
    }
 
@@ -461,10 +462,10 @@
 
      if(verbosity > 3){
       // # nocov start
-      Rcout << std::endl;
-      Rcout << "   -- upper cutpoint: " << lincomb(*it) << std::endl;
-      Rcout << "      - n_obs, right node:   " << n_obs << std::endl;
-      Rcout << std::endl;
+      console() << std::endl;
+      console() << "   -- upper cutpoint: " << lincomb(*it) << std::endl;
+      console() << "      - n_obs, right node:   " << n_obs << std::endl;
+      console() << std::endl;
       // # nocov end
      }
 
@@ -485,7 +486,7 @@
 
    if(verbosity > 2) {
     // # nocov start
-    Rcout << "   -- Could not find valid cut-points" << std::endl;
+    console() << "   -- Could not find valid cut-points" << std::endl;
     // # nocov end
    }
 
@@ -521,22 +522,29 @@
   // value of 1 indicates go to right node
   g_node.ones(lincomb.size());
 
+  init_split_sums();
+
   uvec::iterator it;
 
-  uword it_start = 0, it_best = 0;
+  // n_left is the number of rows (in lincomb_sort order) moved left
+  uword it_start = 0, it_best = 0, n_left = 0;
 
   double stat, stat_best = 0;
 
   if(verbosity > 3){
    // # nocov start
-   Rcout << "   -- cutpoint (score)" << std::endl;
+   console() << "   -- cutpoint (score)" << std::endl;
    // # nocov end
   }
 
   for(it = cuts_sampled.begin(); it != cuts_sampled.end(); ++it){
 
-   // flip node assignments from left to right, up to the next cutpoint
-   g_node.elem(lincomb_sort.subvec(it_start, *it)).fill(0);
+   // flip node assignments from right to left, up to the next cutpoint
+   for( ; n_left <= *it; ++n_left){
+    uword row = lincomb_sort[n_left];
+    g_node[row] = 0;
+    move_split_sums(row);
+   }
    // compute split statistics with this cut-point
    stat = compute_split_score();
    // update leaderboard
@@ -546,11 +554,11 @@
 
    if(verbosity > 3){
     // # nocov start
-    Rcout << "   --- ";
-    Rcout << lincomb.at(lincomb_sort(*it));
-    Rcout << " (" << stat << "), ";
-    Rcout << "N = " << sum(g_node % w_node) << " moving right";
-    Rcout << std::endl;
+    console() << "   --- ";
+    console() << lincomb.at(lincomb_sort(*it));
+    console() << " (" << stat << "), ";
+    console() << "N = " << sum(g_node % w_node) << " moving right";
+    console() << std::endl;
     // # nocov end
    }
 
@@ -558,16 +566,16 @@
 
   if(verbosity > 3){
    // # nocov start
-   Rcout << std::endl;
-   Rcout << "   -- best stat:  " << stat_best;
-   Rcout << ", min to split: " << split_min_stat;
-   Rcout << std::endl;
-   Rcout << std::endl;
+   console() << std::endl;
+   console() << "   -- best stat:  " << stat_best;
+   console() << ", min to split: " << split_min_stat;
+   console() << std::endl;
+   console() << std::endl;
    // # nocov end
   }
 
   // do not split if best stat < minimum stat
-  if(stat_best < split_min_stat){ return(R_PosInf); }
+  if(stat_best < split_min_stat){ return(datum::inf); }
 
   // backtrack g_node to be what it was when best it was found
   if(it_best < it_start){
@@ -623,10 +631,10 @@
  void Tree::sprout_leaf(uword node_id){
 
   if(verbosity > 2){
-   Rcout << "-- sprouting node " << node_id << " into a leaf";
-   Rcout << " (N = " << sum(w_node) << ")";
-   Rcout << std::endl;
-   Rcout << std::endl;
+   console() << "-- sprouting node " << node_id << " into a leaf";
+   console() << " (N = " << sum(w_node) << ")";
+   console() << std::endl;
+   console() << std::endl;
   }
 
   sprout_leaf_internal(node_id);
@@ -666,6 +674,69 @@
 
  }
 
+ std::vector<std::vector<arma::uword>> Tree::find_col_nodes() const {
+
+  // col_nodes[j] holds the ids of the nodes whose linear combination
+  // uses column j, in ascending order. Since child nodes always have
+  // larger ids than their parent, an ancestor comes before its
+  // descendants in each of these vectors.
+  std::vector<std::vector<arma::uword>> col_nodes(n_cols_total);
+
+  for(uword i = 0; i < coef_indices.size(); ++i){
+
+   // leaf nodes have no linear combination
+   if(child_left[i] == 0) continue;
+
+   for(auto& col : coef_indices[i]){
+    col_nodes[col].push_back(i);
+   }
+
+  }
+
+  return(col_nodes);
+
+ }
+
+ arma::uword Tree::predict_leaf_row(const arma::mat& x,
+                                    arma::uword row,
+                                    arma::uword node_id,
+                                    arma::uword negate_col) const {
+
+  // if tree is root node, 0 is the correct leaf prediction
+  if(child_left.empty()) return(0);
+
+  // if child_left == 0, it's a leaf (no need to find next child)
+  while(child_left[node_id] != 0){
+
+   const arma::uvec& cols = coef_indices[node_id];
+   const arma::vec& beta = coef_values[node_id];
+
+   double lincomb_row = 0;
+
+   for(uword k = 0; k < cols.size(); ++k){
+
+    double beta_k = beta[k];
+
+    // negation importance flips the sign of one column's coefficients
+    // without modifying the tree itself
+    if(cols[k] == negate_col) beta_k *= (-1);
+
+    lincomb_row += x.at(row, cols[k]) * beta_k;
+
+   }
+
+   if(lincomb_row <= cutpoint[node_id]){
+    node_id = child_left[node_id];
+   } else {
+    node_id = child_left[node_id] + 1;
+   }
+
+  }
+
+  return(node_id);
+
+ }
+
  void Tree::compute_oobag_vi(arma::vec* vi_numer,
                              VariableImportance vi_type) {
 
@@ -674,66 +745,123 @@
   std::unique_ptr<Data> data_oobag { };
   data_oobag = std::make_unique<Data>(x_oobag, y_oobag, w_oobag);
 
-  // using oobag = false for predict b/c data_oobag is already subsetted
-  predict_leaf(data_oobag.get(), false);
+  arma::mat& x = data_oobag->get_x();
 
-  mat pred_values(data_oobag->n_rows, get_n_col_vi());
+  uword n_rows_oobag = data_oobag->n_rows;
 
-  predict_value_vi(pred_values);
+  uvec leaves(n_rows_oobag, fill::zeros);
+
+  // rows_in_node[i] holds the oobag rows that pass through node i.
+  // Noising column j can only change the route of a row at nodes
+  // that use column j, so after noising, rows are only re-routed
+  // starting from the first node on their path that uses column j.
+  std::vector<std::vector<arma::uword>> rows_in_node(child_left.size());
+
+  // using oobag = false for predictions b/c data_oobag is already subsetted
+  // (if tree is root node, 0 is the correct leaf prediction)
+  for(uword row = 0; row < n_rows_oobag && !child_left.empty(); ++row){
+
+   uword node_id = 0;
+
+   for(; ;){
+
+    rows_in_node[node_id].push_back(row);
+
+    if(child_left[node_id] == 0) break;
+
+    // take one step down the tree
+    uword next_node = child_left[node_id];
+
+    double lincomb_row = 0;
+
+    for(uword k = 0; k < coef_indices[node_id].size(); ++k){
+     lincomb_row += x.at(row, coef_indices[node_id][k]) *
+      coef_values[node_id][k];
+    }
+
+    if(lincomb_row > cutpoint[node_id]) next_node++;
+
+    node_id = next_node;
+
+   }
+
+   leaves[row] = node_id;
+
+  }
+
+  mat pred_values(n_rows_oobag, get_n_col_vi());
+
+  predict_value_vi(leaves, pred_values);
 
   // Compute normal prediction accuracy.
   double accuracy_normal = compute_prediction_accuracy(pred_values);
 
   if(verbosity > 1){
    // # nocov start
-   Rcout << "   -- prediction accuracy before noising: ";
-   Rcout << accuracy_normal << std::endl;
-   Rcout << "   -- mean leaf pred: ";
-   Rcout << mean(conv_to<vec>::from(pred_leaf));
-   Rcout << std::endl << std::endl;
+   console() << "   -- prediction accuracy before noising: ";
+   console() << accuracy_normal << std::endl;
+   console() << "   -- mean leaf pred: ";
+   console() << mean(conv_to<vec>::from(leaves));
+   console() << std::endl << std::endl;
    // # nocov end
   }
 
   random_number_generator.seed(seed);
 
-  // Randomly permute for all independent variables
-  for (uword pred_col = 0; pred_col < data->get_n_cols_x(); ++pred_col) {
+  // leaf predictions without noise, used to undo re-routing
+  uvec leaves_normal = leaves;
 
-   // Check whether the i-th variable is used in the tree:
-   bool pred_is_used = false;
+  // rows whose leaf was re-computed for the current column
+  std::vector<bool> row_rerouted(n_rows_oobag, false);
+  std::vector<arma::uword> rows_rerouted;
+  rows_rerouted.reserve(n_rows_oobag);
 
-   for(uint j = 0; j < coef_indices.size(); ++j){
-    for(uword k = 0; k < coef_indices[j].size(); ++k){
-     if(coef_indices[j][k] == pred_col){
-      pred_is_used = true;
-      break;
-     }
-    }
-   }
+  std::vector<std::vector<arma::uword>> col_nodes = find_col_nodes();
+
+  // Randomly permute for all independent variables
+  for (uword pred_col = 0; pred_col < data->get_n_cols_x(); ++pred_col) {
 
    // proceed if the variable is used in the tree, otherwise vi = 0
-   if (pred_is_used) {
+   if (!col_nodes[pred_col].empty()) {
+
+    // a column index that can't be matched means nothing is negated
+    uword negate_col = n_cols_total;
 
     if(vi_type == VI_PERMUTE){
      // everyone gets the same permutation
      data_oobag->permute_col(pred_col, random_number_generator);
     } else if (vi_type == VI_NEGATE){
-     negate_coef(pred_col);
+     negate_col = pred_col;
     }
 
-    predict_leaf(data_oobag.get(), false);
+    // ancestors come first in col_nodes, so each row is re-routed
+    // from the highest node on its path that uses pred_col.
+    for(auto& node_id : col_nodes[pred_col]){
+
+     for(auto& row : rows_in_node[node_id]){
+
+      if(row_rerouted[row]) continue;
+
+      leaves[row] = predict_leaf_row(x, row, node_id, negate_col);
+
+      row_rerouted[row] = true;
+      rows_rerouted.push_back(row);
 
-    predict_value_vi(pred_values);
+     }
+
+    }
+
+    predict_value_vi(leaves, pred_values);
 
     double accuracy_permuted = compute_prediction_accuracy(pred_values);
 
     if(verbosity > 3){
      // # nocov start
-     Rcout << "   -- prediction accuracy after noising " << pred_col << ": ";
-     Rcout << accuracy_permuted << std::endl;
-     Rcout << "      - mean leaf pred: ";
-     Rcout << mean(conv_to<vec>::from(pred_leaf));
-     Rcout << std::endl << std::endl;
+     console() << "   -- prediction accuracy after noising " << pred_col << ": ";
+     console() << accuracy_permuted << std::endl;
+     console() << "      - mean leaf pred: ";
+     console() << mean(conv_to<vec>::from(leaves));
+     console() << std::endl << std::endl;
      // # nocov end
     }
 
@@ -743,10 +871,15 @@
 
     if(vi_type == VI_PERMUTE){
      data_oobag->restore_col(pred_col);
-    } else if (vi_type == VI_NEGATE){
-     negate_coef(pred_col);
     }
 
+    for(auto& row : rows_rerouted){
+     leaves[row] = leaves_normal[row];
+     row_rerouted[row] = false;
+    }
+
+    rows_rerouted.clear();
+
    }
   }
  }
@@ -756,7 +889,10 @@
                                PartialDepType pd_type,
                                std::vector<arma::mat>& pd_x_vals,
                                std::vector<arma::uvec>& pd_x_cols,
-                               bool oobag) {
+                               bool oobag,
+                               arma::uword row_first,
+                               arma::uword row_last,
+                               PartialDepBuffers& buffers) const {
 
   // a spec is a mat of x-values and umat of x-columns
   // e.g., x_vals = c(1,2,3) and x_cols = c(1,1,1)
@@ -771,28 +907,220 @@
   uword n_specs = pd_x_vals.size();
 
   if(verbosity > 3){
-   Rcout << "   -- n specs: " << n_specs << std::endl;
+   console() << "   -- n specs: " << n_specs << std::endl;
   }
 
+  // result[k][j] has one row for each of row_first, ..., row_last
+  uword n_rows_pred = row_last - row_first + 1;
+
+  uvec rows_pred = find_rows_pred(oobag, row_first, row_last);
+
+  // no out-of-bag rows in this range means nothing to add
+  if(rows_pred.is_empty()) return;
+
+  // leaves.col(j) holds leaf predictions for item j,
+  // with one row for each row in rows_pred
+  umat& leaves = buffers.leaves;
+  uvec& leaves_item = buffers.leaves_item;
+
   for(uword k = 0; k < n_specs; ++k){
 
    uword n_items = pd_x_vals[k].n_rows;
 
    if(verbosity > 3){
-    Rcout << "   -- n items in this spec: " << n_items << std::endl;
+    console() << "   -- n items in this spec: " << n_items << std::endl;
     print_mat(pd_x_vals[k], "x_vals[k]", 5, 5);
    }
 
+   leaves.zeros(rows_pred.size(), n_items);
+
+   predict_leaf_grid(prediction_data->get_x(), rows_pred,
+                     pd_x_vals[k], pd_x_cols[k], buffers);
+
    for(uword j = 0; j < n_items; ++j){
 
-    vec x_val_vec = pd_x_vals[k].row(j).t();
+    // rows that are not predicted are flagged the same way
+    // as predict_leaf() flags in-bag rows
+    leaves_item.set_size(n_rows_pred);
+    leaves_item.fill(max_nodes);
+    leaves_item.elem(rows_pred - row_first) = leaves.col(j);
 
-    if(verbosity > 3){
-     print_vec(x_val_vec, "current row of x_vals", 5);
+    predict_value(leaves_item, result[k][j], pred_type, oobag,
+                  buffers.groups);
+
+   }
+
+  }
+
+ }
+
+ void Tree::predict_leaf_grid(const arma::mat& x,
+                              const arma::uvec& rows,
+                              const arma::mat& pd_x_vals,
+                              const arma::uvec& pd_x_cols,
+                              PartialDepBuffers& buffers) const {
+
+  // if tree is root node, 0 is the correct leaf prediction
+  if(child_left.empty()) return;
+
+  umat& leaves = buffers.leaves;
+
+  uword n_nodes = child_left.size();
+  uword n_items = pd_x_vals.n_rows;
+  uword n_grid_cols = pd_x_cols.size();
+
+  // At node i, the linear combination for a row with grid item j is
+  // the same sum as predict_leaf_row() would compute if the row's
+  // grid columns held item j's values. Terms are added in the same
+  // order, so both routes give the same leaf. Terms before the node's
+  // first grid coefficient don't depend on the item and are summed
+  // once per row; the rest are summed for each item.
+  std::vector<uword>& coef_first = buffers.coef_first;
+  std::vector<uword>& grid_col = buffers.grid_col;
+  std::vector<uword>& grid_first = buffers.grid_first;
+
+  coef_first.assign(n_nodes + 1, 0);
+
+  for(uword i = 0; i < n_nodes; ++i){
+   coef_first[i+1] = coef_first[i] + coef_indices[i].size();
+  }
+
+  grid_col.assign(coef_first[n_nodes], n_grid_cols);
+  grid_first.assign(n_nodes, 0);
+
+  for(uword i = 0; i < n_nodes; ++i){
+
+   uword n_coef = coef_indices[i].size();
+
+   grid_first[i] = n_coef;
+
+   if(child_left[i] == 0) continue;
+
+   for(uword c = 0; c < n_coef; ++c){
+
+    for(uword p = 0; p < n_grid_cols; ++p){
+     if(coef_indices[i][c] == pd_x_cols[p]){
+      grid_col[coef_first[i] + c] = p;
+      break;
+     }
     }
 
-    predict_leaf(prediction_data, oobag, x_val_vec, pd_x_cols[k]);
-    predict_value(result[k][j], pred_type, oobag);
+    if(grid_col[coef_first[i] + c] < n_grid_cols && grid_first[i] == n_coef){
+     grid_first[i] = c;
+    }
+
+   }
+
+  }
+
+  vec& row_terms = buffers.row_terms;
+
+  // items[begin, end) are the grid items routed to the same node
+  struct NodeItems { uword node, begin, end; };
+
+  std::vector<NodeItems> nodes_open;
+  nodes_open.reserve(n_nodes);
+
+  uvec& items = buffers.items;
+  items.set_size(n_items);
+
+  for(uword r = 0; r < rows.size(); ++r){
+
+   uword row = rows[r];
+
+   for(uword j = 0; j < n_items; ++j) items[j] = j;
+
+   nodes_open.push_back({0, 0, n_items});
+
+   while(!nodes_open.empty()){
+
+    NodeItems current = nodes_open.back();
+    nodes_open.pop_back();
+
+    uword i = current.node;
+
+    if(child_left[i] == 0){
+
+     for(uword t = current.begin; t < current.end; ++t){
+      leaves.at(r, items[t]) = i;
+     }
+
+     continue;
+
+    }
+
+    const arma::uvec& cols = coef_indices[i];
+    const arma::vec& beta = coef_values[i];
+
+    uword n_coef = cols.size();
+    uword c_grid = grid_first[i];
+
+    double lincomb_base = 0;
+
+    for(uword c = 0; c < c_grid; ++c){
+     lincomb_base += x.at(row, cols[c]) * beta[c];
+    }
+
+    if(c_grid == n_coef){
+
+     // all items go the same way
+     if(lincomb_base <= cutpoint[i]){
+      nodes_open.push_back({child_left[i], current.begin, current.end});
+     } else {
+      nodes_open.push_back({child_left[i]+1, current.begin, current.end});
+     }
+
+     continue;
+
+    }
+
+    const uword* node_grid_col = grid_col.data() + coef_first[i];
+
+    row_terms.set_size(n_coef - c_grid);
+
+    for(uword c = c_grid; c < n_coef; ++c){
+     if(node_grid_col[c] == n_grid_cols){
+      row_terms[c - c_grid] = x.at(row, cols[c]) * beta[c];
+     }
+    }
+
+    // partition items: left of t_split go left, the rest go right
+    uword t_split = current.begin, t_end = current.end;
+
+    while(t_split < t_end){
+
+     uword j = items[t_split];
+
+     double lincomb = lincomb_base;
+
+     for(uword c = c_grid; c < n_coef; ++c){
+
+      uword p = node_grid_col[c];
+
+      if(p < n_grid_cols){
+       lincomb += pd_x_vals.at(j, p) * beta[c];
+      } else {
+       lincomb += row_terms[c - c_grid];
+      }
+
+     }
+
+     if(lincomb <= cutpoint[i]){
+      t_split++;
+     } else {
+      t_end--;
+      std::swap(items[t_split], items[t_end]);
+     }
+
+    }
+
+    if(t_split > current.begin){
+     nodes_open.push_back({child_left[i], current.begin, t_split});
+    }
+
+    if(t_split < current.end){
+     nodes_open.push_back({child_left[i]+1, t_split, current.end});
+    }
 
    }
 
@@ -803,19 +1131,19 @@
  // # nocov start
  // placeholder
  arma::mat Tree::glm_fit(){
-  Rcpp::stop("default glm fit function called");
+  stop("default glm fit function called");
   mat out;
   return(out);
  }
 
  arma::mat Tree::glmnet_fit(){
-  Rcpp::stop("default glmnet fit function called");
+  stop("default glmnet fit function called");
   mat out;
   return(out);
  }
 
  arma::mat Tree::user_fit(){
-  Rcpp::stop("default user fit function called");
+  stop("default user fit function called");
   mat out;
   return(out);
  }
@@ -823,14 +1151,31 @@
 
  void Tree::grow(arma::vec* oobag_denom,
                  arma::vec* vi_numer,
-                 arma::uvec* vi_denom){
+                 arma::uvec* vi_denom,
+                 WlsWorkspace* wls_workspace,
+                 MemoryTracker* memory){
 
   this->oobag_denom = oobag_denom;
   this->vi_numer = vi_numer;
   this->vi_denom = vi_denom;
+  this->wls_workspace = wls_workspace;
+
+  // p-values from glm fits are only used by anova importance
+  fit_options.do_scale = lincomb_scale;
+  fit_options.ties_method = lincomb_ties_method;
+  fit_options.epsilon = lincomb_eps;
+  fit_options.iter_max = lincomb_iter_max;
+  fit_options.compute_pvalues = (vi_type == VI_ANOVA);
+
+  telemetry = TreeTelemetry();
+  fit_options.n_iter = &telemetry.n_lincomb_iter;
+
+  TimePoint phase_start = time_now();
 
   sample_rows();
 
+  telemetry.time_sample_rows += seconds_since(phase_start);
+
   // create inbag views of x, y, and w,
   this->x_inbag = data->x_rows(rows_inbag);
   this->y_inbag = data->y_rows(rows_inbag);
@@ -845,15 +1190,15 @@
 
   if(verbosity > 2){
    // # nocov start
-   Rcout << "- N obs inbag: " << n_obs_inbag;
-   Rcout << std::endl;
-   Rcout << "- N row inbag: " << n_rows_inbag;
-   Rcout << std::endl;
-   Rcout << "- max nodes: " << max_nodes;
-   Rcout << std::endl;
-   Rcout << "- max leaves: " << max_leaves;
-   Rcout << std::endl;
-   Rcout << std::endl;
+   console() << "- N obs inbag: " << n_obs_inbag;
+   console() << std::endl;
+   console() << "- N row inbag: " << n_rows_inbag;
+   console() << std::endl;
+   console() << "- max nodes: " << max_nodes;
+   console() << std::endl;
+   console() << "- max leaves: " << max_leaves;
+   console() << std::endl;
+   console() << std::endl;
    // # nocov end
   }
 
@@ -865,6 +1210,17 @@
   // memory for leaves based on corresponding tree type
   resize_leaves(max_nodes);
 
+  double bytes_working =
+   (x_inbag.n_elem + y_inbag.n_elem + w_inbag.n_elem) * sizeof(double) +
+   node_assignments.n_elem * sizeof(uword) +
+   max_nodes * (sizeof(double) + sizeof(uword) +
+                sizeof(arma::vec) + sizeof(arma::uvec)) +
+   compute_leaf_bytes();
+
+  // Forest::grow() checks that estimate_grow_bytes(), an upper bound
+  // on bytes_working, fits in max_memory before each tree
+  if(memory) memory->add(bytes_working);
+
   // coordinate the order that nodes are grown.
   std::vector<uword> nodes_open;
 
@@ -887,15 +1243,28 @@
   // ID of the left node (node_right = node_left + 1)
   uword node_left;
 
+  // depth of the nodes in nodes_open (the root has depth 0)
+  uword depth = 0;
+
   do{
 
   for(node = nodes_open.begin(); node != nodes_open.end(); ++node){
 
+   phase_start = time_now();
+
+   bool splittable = is_node_splittable(*node);
+
+   telemetry.time_node_prep += seconds_since(phase_start);
+   telemetry.n_rows_touched += rows_node.n_elem;
+
    // determine rows in the current node and if it can be split
-   if(!is_node_splittable(*node)){
+   if(!splittable){
     // this step creates y_node and w_node for the current node
     // x_node is created once a set of columns are sampled.
+    phase_start = time_now();
     sprout_leaf(*node);
+    telemetry.time_sprout_leaf += seconds_since(phase_start);
+    telemetry.n_leaves++;
     continue;
    }
 
@@ -909,13 +1278,15 @@
    // repeat until all the retries are spent.
     n_retry++;
 
+    if(n_retry > 1) telemetry.n_split_retry++;
+
     if(verbosity > 3){
      // # nocov start
-     Rcout << "-- attempting to split node " << *node;
-     Rcout << " (N = " << sum(w_node) << ",";
-     Rcout << " try number " << n_retry << ")";
-     Rcout << std::endl;
-     Rcout << std::endl;
+     console() << "-- attempting to split node " << *node;
+     console() << " (N = " << sum(w_node) << ",";
+     console() << " try number " << n_retry << ")";
+     console() << std::endl;
+     console() << std::endl;
      // # nocov end
     }
 
@@ -938,6 +1309,8 @@
 
      lincomb.zeros(x_node.n_rows);
 
+     phase_start = time_now();
+
      switch (lincomb_type) {
 
      case LC_GLM: {
@@ -971,6 +1344,9 @@
 
      } // end switch lincomb_type
 
+     telemetry.time_lincomb += seconds_since(phase_start);
+     telemetry.n_lincomb_fits++;
+
      vec beta_est = beta.unsafe_col(0);
 
      if(verbosity > 3) {
@@ -985,16 +1361,23 @@
 
       lincomb = x_node * beta_est;
 
+      phase_start = time_now();
+
       // sorted in ascending order
       lincomb_sort = sort_index(lincomb);
 
+      telemetry.time_sort_index += seconds_since(phase_start);
+      phase_start = time_now();
+
       // find all valid cutpoints for lincomb
       find_all_cuts();
 
+      telemetry.time_find_all_cuts += seconds_since(phase_start);
+
       if(verbosity > 3 && cuts_all.is_empty()){
        // # nocov start
-       Rcout << "   -- no cutpoints identified";
-       Rcout << std::endl;
+       console() << "   -- no cutpoints identified";
+       console() << std::endl;
        // # nocov end
       }
 
@@ -1003,9 +1386,13 @@
 
        sample_cuts();
 
+       phase_start = time_now();
+
        double cut_point = find_best_cut();
 
-       if(cut_point < R_PosInf){
+       telemetry.time_find_best_cut += seconds_since(phase_start);
+
+       if(cut_point < datum::inf){
 
         if(vi_type == VI_ANOVA && lincomb_type == LC_GLM){
 
@@ -1015,7 +1402,7 @@
 
          if(verbosity > 3){
           // # nocov start
-          Rcout << "   -- p-values:" << std::endl;
+          console() << "   -- p-values:" << std::endl;
           // # nocov end
          }
 
@@ -1033,13 +1420,13 @@
 
            if(verbosity > 3){
             // # nocov start
-            Rcout << "   --- column " << cols_node[i] << ": ";
-            Rcout << pvalue;
-            if(pvalue < 0.05) Rcout << "*";
-            if(pvalue < 0.01) Rcout << "*";
-            if(pvalue < 0.001) Rcout << "*";
-            if(pvalue < vi_max_pvalue) Rcout << " [+1 to VI numerator]";
-            Rcout << std::endl;
+            console() << "   --- column " << cols_node[i] << ": ";
+            console() << pvalue;
+            if(pvalue < 0.05) console() << "*";
+            if(pvalue < 0.01) console() << "*";
+            if(pvalue < 0.001) console() << "*";
+            if(pvalue < vi_max_pvalue) console() << " [+1 to VI numerator]";
+            console() << std::endl;
             // # nocov end
            }
 
@@ -1051,7 +1438,7 @@
 
          if(verbosity > 3){
           // # nocov start
-          Rcout << std::endl;
+          console() << std::endl;
           // # nocov end
          }
 
@@ -1066,17 +1453,25 @@
         coef_indices[*node] = cols_node;
 
         child_left[*node] = node_left;
+
+        phase_start = time_now();
+
         // re-assign observations in the current node
         // (note that g_node is 0 if left, 1 if right)
         node_assignments.elem(rows_node) = node_left + g_node;
 
+        telemetry.time_routing += seconds_since(phase_start);
+
+        // children of this node are one level deeper
+        if(depth + 1 > telemetry.max_depth) telemetry.max_depth = depth + 1;
+
         if(verbosity > 2){
          // # nocov start
-         Rcout << "-- node " << *node << " was split into ";
-         Rcout << "node " << node_left << " (left) and ";
-         Rcout << node_left+1 << " (right)";
-         Rcout << std::endl;
-         Rcout << std::endl;
+         console() << "-- node " << *node << " was split into ";
+         console() << "node " << node_left << " (left) and ";
+         console() << node_left+1 << " (right)";
+         console() << std::endl;
+         console() << std::endl;
          // # nocov end
         }
 
@@ -1097,7 +1492,10 @@
     if(cols_node.is_empty()) n_retry = split_max_retry;
 
     if(n_retry >= split_max_retry){
+     phase_start = time_now();
      sprout_leaf(*node);
+     telemetry.time_sprout_leaf += seconds_since(phase_start);
+     telemetry.n_leaves++;
      break;
     }
 
@@ -1108,12 +1506,15 @@
 
   nodes_open = nodes_queued;
   nodes_queued.clear();
+  depth++;
 
   } while (nodes_open.size() > 0);
 
   // don't forget to count the root node
   n_nodes++;
 
+  telemetry.n_nodes = n_nodes;
+
   cutpoint.resize(n_nodes);
   child_left.resize(n_nodes);
   coef_values.resize(n_nodes);
@@ -1121,219 +1522,215 @@
 
   resize_leaves(n_nodes);
 
+  if(memory) memory->remove(bytes_working);
+
  } // Tree::grow
 
  void Tree::predict_leaf(Data* prediction_data,
-                         bool oobag) {
-
-  pred_leaf.zeros(prediction_data->n_rows);
-
-  // if tree is root node, 0 is the correct leaf prediction
-  if(coef_values.size() == 0) return;
+                         bool oobag,
+                         arma::uvec& leaves) const {
 
-  if(verbosity > 2){
-   // # nocov start
-   Rcout << "   -- computing leaf predictions" << std::endl;
-   // # nocov end
+  if(prediction_data->n_rows == 0){
+   leaves.reset();
+   return;
   }
 
-  uvec obs_in_node;
-
-  // it iterates over the observations in a node
-  uvec::iterator it;
-
-  // i iterates over nodes, j over observations
-  // uword i, j;
-
-  for(uword i = 0; i < coef_values.size(); i++){
-
-   // if child_left == 0, it's a leaf (no need to find next child)
-   if(child_left[i] != 0){
-
-    if(i == 0 && oobag){
-     obs_in_node = rows_oobag;
-    } else if (i == 0 && !oobag) {
-     obs_in_node = regspace<uvec>(0, 1, pred_leaf.size()-1);
-    } else {
-     obs_in_node = find(pred_leaf == i);
-    }
-
-    if(obs_in_node.size() > 0){
+  predict_leaf(prediction_data, oobag,
+               0, prediction_data->n_rows - 1, leaves);
 
-     lincomb = prediction_data->x_submat_mult_beta(obs_in_node,
-                                                   coef_indices[i],
-                                                   coef_values[i]);
-
-     it = obs_in_node.begin();
-
-     for(uword j = 0; j < obs_in_node.size(); ++j, ++it){
-
-      if(lincomb[j] <= cutpoint[i]) {
-
-       pred_leaf[*it] = child_left[i];
-
-      } else {
-
-       pred_leaf[*it] = child_left[i]+1;
-
-      }
+ }
 
-     }
+ arma::uvec Tree::find_rows_pred(bool oobag,
+                                 arma::uword row_first,
+                                 arma::uword row_last) const {
 
-     if(verbosity > 4){
-      // # nocov start
-      uvec in_left = find(pred_leaf == child_left[i]);
-      uvec in_right = find(pred_leaf == child_left[i]+1);
-      Rcout << "No. to node " << child_left[i] << ": ";
-      Rcout << in_left.size() << "; " << std::endl;
-      Rcout << "No. to node " << child_left[i]+1 << ": ";
-      Rcout << in_right.size() << std::endl << std::endl;
-      // # nocov end
-     }
+  if(!oobag) return(regspace<uvec>(row_first, 1, row_last));
 
-    }
+  // rows_oobag is sorted, so its rows in this range are contiguous
+  uvec::const_iterator first = std::lower_bound(rows_oobag.begin(),
+                                                rows_oobag.end(),
+                                                row_first);
 
-   }
+  uvec::const_iterator last = std::upper_bound(first,
+                                               rows_oobag.end(),
+                                               row_last);
 
-  }
+  if(first == last) return(uvec());
 
-  if(oobag){ pred_leaf.elem(rows_inbag).fill(max_nodes); }
+  return(rows_oobag.subvec(first - rows_oobag.begin(),
+                           last - rows_oobag.begin() - 1));
 
  }
 
  void Tree::predict_leaf(Data* prediction_data,
                          bool oobag,
-                         arma::vec& pd_x_vals,
-                         arma::uvec& pd_x_cols){
+                         arma::uword row_first,
+                         arma::uword row_last,
+                         arma::uvec& leaves) const {
 
-  pred_leaf.zeros(prediction_data->n_rows);
+  // leaves gets one value for each of row_first, ..., row_last,
+  // with max_nodes for rows that are not predicted (i.e., in-bag
+  // rows when oobag is true).
 
-  // if tree is root node, 0 is the correct leaf prediction
-  if(coef_values.size() == 0) return;
-
-  if(verbosity > 2){
-   // # nocov start
-   Rcout << "   -- computing dependence leaf predictions" << std::endl;
-   // # nocov end
-  }
-
-  uvec obs_in_node;
-
-  // it iterates over the observations in a node
-  uvec::iterator it;
+  leaves.set_size(row_last - row_first + 1);
+  leaves.fill(max_nodes);
 
-  // i iterates over nodes, j over observations
-  // uword i, j;
+  uvec rows_pred = find_rows_pred(oobag, row_first, row_last);
 
-  for(uword i = 0; i < coef_values.size(); i++){
-
-   // if child_left == 0, it's a leaf (no need to find next child)
-   if(child_left[i] != 0){
+  // if tree is root node, 0 is the correct leaf prediction
+  if(coef_values.size() == 0){
+   leaves.elem(rows_pred - row_first).zeros();
+   return;
+  }
 
-    if(i == 0 && oobag){
-     obs_in_node = rows_oobag;
-    } else if (i == 0 && !oobag) {
-     obs_in_node = regspace<uvec>(0, 1, pred_leaf.size()-1);
-    } else {
-     obs_in_node = find(pred_leaf == i);
-    }
+  arma::mat& x = prediction_data->get_x();
 
-    if(obs_in_node.size() > 0){
+  // a column index that no node uses, i.e., negate nothing
+  uword negate_none = prediction_data->n_cols_x;
 
-     lincomb = prediction_data->x_submat_mult_beta(obs_in_node,
-                                                   coef_indices[i],
-                                                   coef_values[i],
-                                                   pd_x_vals,
-                                                   pd_x_cols);
+  for(auto& row : rows_pred){
+   leaves[row - row_first] = predict_leaf_row(x, row, 0, negate_none);
+  }
 
-     it = obs_in_node.begin();
+ }
 
-     for(uword j = 0; j < obs_in_node.size(); ++j, ++it){
+ void Tree::group_rows_by_leaf(const arma::uvec& leaves,
+                               LeafGroups& groups) const {
 
-      if(lincomb[j] <= cutpoint[i]) {
+  // leaf ids are node ids, so rows can be grouped by leaf with one
+  // counting pass instead of sorting. Rows flagged with max_nodes
+  // (i.e., rows that are not predicted) are left out.
+  uword n_nodes = std::max<uword>(child_left.size(), 1);
 
-       pred_leaf[*it] = child_left[i];
+  // after the loops below, leaf_first[i] is the position in
+  // rows_grouped where the rows of node i begin. assign() keeps
+  // the capacity from earlier trees.
+  std::vector<uword>& leaf_first = groups.leaf_first;
+  leaf_first.assign(n_nodes + 1, 0);
 
-      } else {
+  uvec& leaf_ids = groups.leaf_ids;
+  uvec& leaf_bounds = groups.leaf_bounds;
+  uvec& rows_grouped = groups.rows_grouped;
 
-       pred_leaf[*it] = child_left[i]+1;
+  for(auto& leaf : leaves){
+   if(leaf < n_nodes) leaf_first[leaf + 1]++;
+  }
 
-      }
+  uword n_groups = 0;
 
-     }
+  for(uword i = 0; i < n_nodes; ++i){
+   if(leaf_first[i + 1] > 0) n_groups++;
+   leaf_first[i + 1] += leaf_first[i];
+  }
 
-     if(verbosity > 4){
-      // # nocov start
-      uvec in_left = find(pred_leaf == child_left[i]);
-      uvec in_right = find(pred_leaf == child_left[i]+1);
-      Rcout << "No. to node " << child_left[i] << ": ";
-      Rcout << in_left.size() << "; " << std::endl;
-      Rcout << "No. to node " << child_left[i]+1 << ": ";
-      Rcout << in_right.size() << std::endl << std::endl;
-      // # nocov end
-     }
+  leaf_ids.set_size(n_groups);
+  leaf_bounds.set_size(n_groups + 1);
+  rows_grouped.set_size(leaf_first[n_nodes]);
 
-    }
+  uword g = 0;
 
+  for(uword i = 0; i < n_nodes; ++i){
+   if(leaf_first[i + 1] > leaf_first[i]){
+    leaf_ids[g] = i;
+    leaf_bounds[g] = leaf_first[i];
+    g++;
    }
-
   }
 
-  if(oobag){ pred_leaf.elem(rows_inbag).fill(max_nodes); }
+  leaf_bounds[n_groups] = leaf_first[n_nodes];
+
+  // rows stay in ascending order within each leaf
+  for(uword row = 0; row < leaves.size(); ++row){
+   uword leaf = leaves[row];
+   if(leaf < n_nodes) rows_grouped[leaf_first[leaf]++] = row;
+  }
 
  }
 
- void Tree::predict_value(arma::mat& pred_output,
+ void Tree::predict_value(arma::uvec& leaves,
+                          arma::mat& pred_output,
                           PredType   pred_type,
-                          bool       oobag){
+                          bool       oobag,
+                          LeafGroups& groups) const {
 
   if(verbosity > 2){
    // # nocov start
-   uvec tmp_uvec = find(pred_leaf < max_nodes);
+   uvec tmp_uvec = find(leaves < max_nodes);
 
    if(tmp_uvec.size() == 0){
-    Rcout << pred_leaf                  << std::endl;
-    Rcout << "max_nodes: " << max_nodes << std::endl;
+    console() << leaves                     << std::endl;
+    console() << "max_nodes: " << max_nodes << std::endl;
    }
 
-   Rcout << "   -- N preds expected: " << tmp_uvec.size() << std::endl;
+   console() << "   -- N preds expected: " << tmp_uvec.size() << std::endl;
    // # nocov end
   }
 
-  uvec pred_leaf_sort = sort_index(pred_leaf, "ascend");
+  group_rows_by_leaf(leaves, groups);
 
-  uword n_preds_made = predict_value_internal(pred_leaf_sort,
+  // nothing to predict, e.g., a block of rows that are all in-bag
+  if(groups.leaf_ids.is_empty()) return;
+
+  uword n_preds_made = predict_value_internal(groups.leaf_ids,
+                                              groups.leaf_bounds,
+                                              groups.rows_grouped,
                                               pred_output,
                                               pred_type,
                                               oobag);
 
   if(verbosity > 2){
    // # nocov start
-   Rcout << "   -- N preds made: " << n_preds_made;
-   Rcout << std::endl;
-   Rcout << std::endl;
+   console() << "   -- N preds made: " << n_preds_made;
+   console() << std::endl;
+   console() << std::endl;
    // # nocov end
   }
 
  }
 
- double Tree::compute_prediction_accuracy(arma::mat& preds){
+ ModelBytes Tree::compute_model_bytes() const {
 
-  return(compute_prediction_accuracy_internal(preds));
+  ModelBytes result;
+
+  result.nodes = cutpoint.size() * sizeof(double) +
+   child_left.size() * sizeof(uword);
+
+  for(uword i = 0; i < coef_values.size(); ++i){
+   result.coefficients += sizeof(arma::vec) + sizeof(arma::uvec) +
+    coef_values[i].n_elem * sizeof(double) +
+    coef_indices[i].n_elem * sizeof(uword);
+  }
+
+  result.leaves = compute_leaf_bytes();
+
+  result.oobag_rows = rows_oobag.n_elem * sizeof(uword);
+
+  return(result);
 
  }
 
- void Tree::negate_coef(arma::uword pred_col){
+ double Tree::compute_leaf_bytes() const {
 
-  for(uint j = 0; j < coef_indices.size(); ++j){
+  return(leaf_summary.size() * sizeof(double));
 
-   for(uword k = 0; k < coef_indices[j].size(); ++k){
-    if(coef_indices[j][k] == pred_col){
-     coef_values[j][k] *= (-1);
-    }
-   }
+ }
 
-  }
+ void Tree::write_binary(ForestFileWriter& file) const {
+
+  file.write_uvec(rows_oobag);
+  file.write_vector(cutpoint);
+  file.write_vector(child_left);
+  file.write_vecs(coef_values);
+  file.write_uvecs(coef_indices);
+  file.write_vector(leaf_summary);
+
+  write_binary_leaves(file);
+
+ }
+
+ double Tree::compute_prediction_accuracy(arma::mat& preds){
+
+  return(compute_prediction_accuracy_internal(preds));
 
  }
 
@@ -8,24 +8,71 @@
 #define TREE_H_
 
 #include "Data.h"
+#include "ForestFile.h"
 #include "globals.h"
+#include "Telemetry.h"
 #include "utility.h"
 
+#include <random>
+
  namespace aorsf {
 
+ // rows grouped by the leaf they land in (see Tree::group_rows_by_leaf)
+ //
+ // @description rows_grouped[leaf_bounds[g]], ...,
+ //   rows_grouped[leaf_bounds[g+1] - 1] are the rows in leaf
+ //   leaf_ids[g]. The grouping changes with every tree, but its
+ //   memory doesn't need to: each prediction thread keeps one of
+ //   these and re-uses it for all of its trees.
+ //
+ struct LeafGroups {
+  arma::uvec leaf_ids;
+  arma::uvec leaf_bounds;
+  arma::uvec rows_grouped;
+  // position in rows_grouped where the rows of each node begin
+  std::vector<arma::uword> leaf_first;
+ };
+
+ // memory for partial dependence (see Tree::compute_dependence)
+ //
+ // @description like LeafGroups, each thread that computes partial
+ //   dependence keeps one of these and re-uses it for all of its trees.
+ //
+ struct PartialDepBuffers {
+  // leaves.col(j) holds leaf predictions for grid item j
+  arma::umat leaves;
+  // leaf predictions for one item, one row per row in the result
+  arma::uvec leaves_item;
+  LeafGroups groups;
+  // grid_col[coef_first[i] + c] is the grid column that coefficient c
+  // of node i multiplies, or the number of grid columns if none.
+  std::vector<arma::uword> coef_first;
+  std::vector<arma::uword> grid_col;
+  // position of the first coefficient of node i on a grid column
+  // (the number of coefficients of node i if there is none)
+  std::vector<arma::uword> grid_first;
+  // products of x and the coefficients from grid_first on, for one row
+  arma::vec row_terms;
+  // grid items, ordered so that items routed to the same node are
+  // next to each other
+  arma::uvec items;
+ };
+
  class Tree {
 
  public:
 
   Tree();
 
-  // Create from loaded forest
-  Tree(arma::uvec& rows_oobag,
-       std::vector<double>& cutpoint,
-       std::vector<arma::uword>& child_left,
-       std::vector<arma::vec>& coef_values,
-       std::vector<arma::uvec>& coef_indices,
-       std::vector<double>& leaf_summary);
+  // Create from loaded forest. Inputs are taken by value and moved
+  // into the tree, so callers can hand over their memory (e.g., vecs
+  // that view a memory mapped file) with std::move.
+  Tree(arma::uvec rows_oobag,
+       std::vector<double> cutpoint,
+       std::vector<arma::uword> child_left,
+       std::vector<arma::vec> coef_values,
+       std::vector<arma::uvec> coef_indices,
+       std::vector<double> leaf_summary);
 
   virtual ~Tree() = default;
 
@@ -57,8 +104,8 @@
             double lincomb_alpha,
             arma::uword lincomb_df_target,
             arma::uword lincomb_ties_method,
-            Rcpp::RObject lincomb_R_function,
-            Rcpp::RObject oobag_R_function,
+            LincombFunction lincomb_function,
+            EvalFunction oobag_eval_function,
             EvalType oobag_eval_type,
             int verbosity);
 
@@ -73,6 +120,10 @@
 
   bool is_node_splittable(arma::uword node_id);
 
+  // summaries of y_node that every split and leaf in the node can
+  // share (e.g., tie groups of survival times)
+  virtual void prep_node_internal() { }
+
   virtual bool is_node_splittable_internal();
 
   virtual void find_all_cuts();
@@ -81,6 +132,13 @@
 
   virtual double compute_split_score();
 
+  // split scores that only depend on weighted sums over each side of
+  // a cut keep those sums here, so that each cut in find_best_cut()
+  // is scored in O(1) as rows move from the right node to the left.
+  virtual void init_split_sums() { }
+
+  virtual void move_split_sums(arma::uword row) { }
+
   void sample_cuts();
 
   double find_best_cut();
@@ -91,28 +149,66 @@
 
   virtual double compute_max_leaves();
 
+  // working memory of the tree (inbag copies and reservations for
+  // nodes and leaves) is added to memory while the tree grows
   void grow(arma::vec* oobag_denom,
             arma::vec* vi_numer,
-            arma::uvec* vi_denom);
+            arma::uvec* vi_denom,
+            WlsWorkspace* wls_workspace,
+            MemoryTracker* memory);
 
-  void predict_leaf(Data* prediction_data,
-                    bool oobag);
+  // Prediction does not modify the tree: routing scratch lives in
+  // caller-provided buffers, so any number of threads can predict
+  // with the same tree at the same time.
 
   void predict_leaf(Data* prediction_data,
                     bool oobag,
-                    arma::vec& pd_x_vals,
-                    arma::uvec& pd_x_cols);
+                    arma::uvec& leaves) const;
 
-  void predict_value(arma::mat& pred_output,
+  void predict_leaf(Data* prediction_data,
+                    bool oobag,
+                    arma::uword row_first,
+                    arma::uword row_last,
+                    arma::uvec& leaves) const;
+
+  arma::uvec find_rows_pred(bool oobag,
+                            arma::uword row_first,
+                            arma::uword row_last) const;
+
+  void predict_leaf_grid(const arma::mat& x,
+                         const arma::uvec& rows,
+                         const arma::mat& pd_x_vals,
+                         const arma::uvec& pd_x_cols,
+                         PartialDepBuffers& buffers) const;
+
+  // groups holds the rows of leaves grouped by leaf when this
+  // returns; passing the same groups for every tree re-uses its memory
+  void predict_value(arma::uvec& leaves,
+                     arma::mat& pred_output,
                      PredType pred_type,
-                     bool oobag);
+                     bool oobag,
+                     LeafGroups& groups) const;
 
-  virtual arma::uword predict_value_internal(arma::uvec& pred_leaf_sort,
+  // The grouping does not depend on pred_type, so it can be
+  // re-used to compute more than one type of prediction.
+  void group_rows_by_leaf(const arma::uvec& leaves,
+                          LeafGroups& groups) const;
+
+  virtual arma::uword predict_value_internal(const arma::uvec& leaf_ids,
+                                             const arma::uvec& leaf_bounds,
+                                             const arma::uvec& rows_grouped,
                                              arma::mat& pred_output,
                                              PredType pred_type,
-                                             bool oobag) = 0;
+                                             bool oobag) const = 0;
+
+  // negate_col is a column whose coefficients have their sign
+  // flipped while routing, or a column index that no node uses.
+  arma::uword predict_leaf_row(const arma::mat& x,
+                               arma::uword row,
+                               arma::uword node_id,
+                               arma::uword negate_col) const;
 
-  void negate_coef(arma::uword pred_col);
+  std::vector<std::vector<arma::uword>> find_col_nodes() const;
 
   void compute_oobag_vi(arma::vec* vi_numer, VariableImportance vi_type);
 
@@ -121,7 +217,10 @@
                           PartialDepType pd_type,
                           std::vector<arma::mat>& pd_x_vals,
                           std::vector<arma::uvec>& pd_x_cols,
-                          bool oobag);
+                          bool oobag,
+                          arma::uword row_first,
+                          arma::uword row_last,
+                          PartialDepBuffers& buffers) const;
 
   std::vector<arma::uvec>& get_coef_indices() {
    return(coef_indices);
@@ -152,8 +251,8 @@
    return(child_left);
   }
 
-  arma::uvec& get_pred_leaf(){
-   return(pred_leaf);
+  const TreeTelemetry& get_telemetry() const {
+   return(telemetry);
   }
 
   arma::uvec& get_cuts_all(){
@@ -231,9 +330,21 @@
   virtual arma::mat glmnet_fit();
   virtual arma::mat user_fit();
 
+  // writes this tree's fields in the order Forest::load_binary()
+  // reads them, followed by the leaf tables of the tree type.
+  void write_binary(ForestFileWriter& file) const;
+
+  virtual void write_binary_leaves(ForestFileWriter& file) const = 0;
+
+  ModelBytes compute_model_bytes() const;
+
+  // bytes held by leaf_summary and the leaf tables of the tree type
+  virtual double compute_leaf_bytes() const;
+
   virtual uword get_n_col_vi()=0;
 
-  virtual void predict_value_vi(arma::mat& pred_values)=0;
+  virtual void predict_value_vi(arma::uvec& leaves,
+                                arma::mat& pred_values) const = 0;
 
  protected:
 
@@ -246,6 +357,15 @@
   arma::vec* vi_numer;
   arma::uvec* vi_denom;
 
+  // pointer to the growing thread's memory for glm fits
+  WlsWorkspace* wls_workspace;
+
+  // lincomb settings for glm fits, filled in by grow()
+  FitOptions fit_options;
+
+  // counters and timers from the last call to grow()
+  TreeTelemetry telemetry;
+
   // // pointers to partial dependence inputs in forest
   // PartialDepType pd_type;
   // std::vector<arma::mat>* pd_x_vals;
@@ -317,19 +437,20 @@
   arma::uword split_max_retry;
 
   // linear combination members
-  LinearCombo   lincomb_type;
-  arma::vec     lincomb;
-  arma::uvec    lincomb_sort;
-  double        lincomb_eps;
-  arma::uword   lincomb_iter_max;
-  bool          lincomb_scale;
-  double        lincomb_alpha;
-  arma::uword   lincomb_df_target;
-  arma::uword   lincomb_ties_method;
-  Rcpp::RObject lincomb_R_function;
+  LinearCombo     lincomb_type;
+  arma::vec       lincomb;
+  arma::uvec      lincomb_sort;
+  double          lincomb_eps;
+  arma::uword     lincomb_iter_max;
+  bool            lincomb_scale;
+  double          lincomb_alpha;
+  arma::uword     lincomb_df_target;
+  arma::uword     lincomb_ties_method;
+  // glmnet or a user supplied function (see Runtime.h)
+  LincombFunction lincomb_function;
 
   // allow customization of oobag prediction accuracy
-  Rcpp::RObject oobag_R_function;
+  EvalFunction oobag_eval_function;
   EvalType oobag_eval_type;
 
   int verbosity;
@@ -347,9 +468,6 @@
   arma::uvec cols_node;
 
 
-  // predicted leaf node
-  arma::uvec pred_leaf;
-
   // which node each inbag observation is currently in.
   arma::uvec node_assignments;
 
@@ -4,14 +4,13 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "TreeClassification.h"
 #include "Coxph.h"
 #include "utility.h"
 // #include "NodeSplitStats.h"
 
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
@@ -24,15 +23,20 @@
 
  TreeClassification::TreeClassification(arma::uword n_obs,
                                         arma::uword n_class,
-                                        arma::uvec& rows_oobag,
-                                        std::vector<double>& cutpoint,
-                                        std::vector<arma::uword>& child_left,
-                                        std::vector<arma::vec>& coef_values,
-                                        std::vector<arma::uvec>& coef_indices,
-                                        std::vector<arma::vec>& leaf_pred_prob,
-                                        std::vector<double>& leaf_summary) :
- Tree(rows_oobag, cutpoint, child_left, coef_values, coef_indices, leaf_summary),
- leaf_pred_prob(leaf_pred_prob){
+                                        arma::uvec rows_oobag,
+                                        std::vector<double> cutpoint,
+                                        std::vector<arma::uword> child_left,
+                                        std::vector<arma::vec> coef_values,
+                                        std::vector<arma::uvec> coef_indices,
+                                        std::vector<arma::vec> leaf_pred_prob,
+                                        std::vector<double> leaf_summary) :
+ Tree(std::move(rows_oobag),
+      std::move(cutpoint),
+      std::move(child_left),
+      std::move(coef_values),
+      std::move(coef_indices),
+      std::move(leaf_summary)),
+ leaf_pred_prob(std::move(leaf_pred_prob)){
 
   this->n_class = n_class;
   this->binary = n_class == 2;
@@ -48,27 +52,48 @@
  }
 
 
+ void TreeClassification::init_split_sums(){
+
+  vec y_i = y_node.unsafe_col(y_col_split);
+
+  w_node_sum = sum(w_node);
+  y_node_sum = dot(y_i, w_node);
+
+  w_left_sum = 0;
+  y_left_sum = 0;
+
+ }
+
+ void TreeClassification::move_split_sums(arma::uword row){
+
+  w_left_sum += w_node[row];
+  y_left_sum += w_node[row] * y_node.at(row, y_col_split);
+
+ }
+
  double TreeClassification::compute_split_score(){
 
   double result=0;
 
+  double w_right_sum = w_node_sum - w_left_sum;
+  double y_right_sum = y_node_sum - y_left_sum;
+
   switch (split_rule) {
 
   case SPLIT_GINI: {
 
-   vec y_i = y_node.unsafe_col(y_col_split);
-
    // gini index: lower is better, so
    // transform to make consistent with other stats
-   result = 1 - compute_gini(y_i, w_node, g_node);
+   result = 1 - compute_gini(w_left_sum, y_left_sum,
+                             w_right_sum, y_right_sum);
 
    break;
   }
 
   case SPLIT_CONCORD: {
 
-   vec y_i = y_node.unsafe_col(y_col_split);
-   result = compute_cstat_clsf(y_i, w_node, g_node);
+   result = compute_cstat_clsf(w_left_sum, y_left_sum,
+                               w_right_sum, y_right_sum);
 
    // if the split has good 'anti-prediction':
    if(result < 0.50){ result = 1 - result; }
@@ -96,57 +121,53 @@
  }
 
  arma::uword TreeClassification::predict_value_internal(
-   arma::uvec& pred_leaf_sort,
+   const arma::uvec& leaf_ids,
+   const arma::uvec& leaf_bounds,
+   const arma::uvec& rows_grouped,
    arma::mat& pred_output,
    PredType pred_type,
    bool oobag
- ){
+ ) const {
 
   uword n_preds_made = 0;
 
-  if(pred_type == PRED_PROBABILITY){
+  for(uword g = 0; g < leaf_ids.size(); ++g){
 
-   for(auto& it : pred_leaf_sort){
+   uword leaf_id = leaf_ids[g];
 
-    uword leaf_id = pred_leaf[it];
+   for(uword r = leaf_bounds[g]; r < leaf_bounds[g+1]; ++r){
 
-    // the stopping condition for oobag predictions
-    if(leaf_id == max_nodes) break;
+    uword row = rows_grouped[r];
 
-    // usual case: a prediction matrix with one column per class
-    if(pred_output.n_cols > 1){
-     pred_output.row(it) += leaf_pred_prob[leaf_id].t();
-     n_preds_made++;
-    }
+    if(pred_type == PRED_PROBABILITY){
 
-    // unusual case: a single column matrix
-    // this occurs when pred_aggregate is false in forest.cpp's predict
-    if(pred_output.n_cols == 1){
-     pred_output.at(it, 0) += leaf_pred_prob[leaf_id][1];
-     n_preds_made++;
-    }
+     // usual case: a prediction matrix with one column per class
+     if(pred_output.n_cols > 1){
+      pred_output.row(row) += leaf_pred_prob[leaf_id].t();
+     }
 
-   }
+     // unusual case: a single column matrix
+     // this occurs when pred_aggregate is false in forest.cpp's predict
+     if(pred_output.n_cols == 1){
+      pred_output.at(row, 0) += leaf_pred_prob[leaf_id][1];
+     }
 
-  } else if(pred_type == PRED_CLASS){
+    } else if(pred_type == PRED_CLASS){
 
-   for(auto& it : pred_leaf_sort){
+     // usual case: a prediction matrix with one column per class
+     if(pred_output.n_cols > 1){
+      pred_output.at(row, leaf_summary[leaf_id])++;
+     }
 
-    uword leaf_id = pred_leaf[it];
-    if(leaf_id == max_nodes) break;
+     // unusual case: a single column matrix
+     // this occurs when pred_aggregate is false in forest.cpp's predict
+     if(pred_output.n_cols == 1){
+      pred_output.at(row, 0) = leaf_summary[leaf_id];
+     }
 
-    // usual case: a prediction matrix with one column per class
-    if(pred_output.n_cols > 1){
-     pred_output.at(it, leaf_summary[leaf_id])++;
-     n_preds_made++;
     }
 
-    // unusual case: a single column matrix
-    // this occurs when pred_aggregate is false in forest.cpp's predict
-    if(pred_output.n_cols == 1){
-     pred_output.at(it, 0) = leaf_summary[leaf_id];
-     n_preds_made++;
-    }
+    n_preds_made++;
 
    }
 
@@ -163,9 +184,8 @@
   mat out = logreg_fit(x_node,
                        y_col,
                        w_node,
-                       lincomb_scale,
-                       lincomb_eps,
-                       lincomb_iter_max);
+                       fit_options,
+                       *wls_workspace);
 
   return(out);
 
@@ -175,21 +195,8 @@
 
   arma::vec y_col = y_node.unsafe_col(y_col_split);
 
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_col);
-  NumericVector ww = wrap(w_node);
-
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
-
-  NumericMatrix beta_R = f_beta(xx, yy, ww,
-                                lincomb_alpha,
-                                lincomb_df_target);
-
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
-
-  return(beta);
+  // lincomb_alpha and lincomb_df_target are bound to the function
+  return(lincomb_function(x_node, y_col, w_node));
 
  }
 
@@ -197,19 +204,7 @@
 
   vec y_col = y_node.unsafe_col(y_col_split);
 
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_col);
-  NumericVector ww = wrap(w_node);
-
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
-
-  NumericMatrix beta_R = f_beta(xx, yy, ww);
-
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
-
-  return(beta);
+  return(lincomb_function(x_node, y_col, w_node));
 
  }
 
@@ -230,24 +225,12 @@
 
   if (oobag_eval_type == EVAL_R_FUNCTION){
 
-   // initialize function from tree object
-   // (Functions can't be stored in C++ classes, but RObjects can)
-   Function f_oobag_eval = as<Function>(oobag_R_function);
-
-   NumericVector w_ = wrap(w_oobag);
-
    for(uword i = start; i < preds.n_cols; ++i){
 
     vec y_i = y_oobag.unsafe_col(i);
     vec p_i = preds.unsafe_col(i);
 
-    NumericVector y_ = wrap(y_i);
-    NumericVector p_ = wrap(p_i);
-    NumericVector R_result = f_oobag_eval(y_, w_, p_);
-
-    double result_addon = R_result[0];
-
-    result += result_addon;
+    result += oobag_eval_function(y_i, w_oobag, p_i);
 
    }
 
@@ -285,9 +268,9 @@
   double y_sum_cases = sum(y_node.col(1));
 
   if(verbosity > 3){
-   Rcout << "   -- Y sums (unweighted): ";
-   Rcout << y_sum_cases << " cases, ";
-   Rcout << y_sum_ctrls << " controls" << std::endl;
+   console() << "   -- Y sums (unweighted): ";
+   console() << y_sum_cases << " cases, ";
+   console() << y_sum_ctrls << " controls" << std::endl;
   }
 
   splittable_y_cols.zeros(1);
@@ -315,8 +298,8 @@
   }
 
   if(verbosity > 3){
-   Rcout << "   -- No y columns are splittable";
-   Rcout << std::endl << std::endl;
+   console() << "   -- No y columns are splittable";
+   console() << std::endl << std::endl;
   }
 
   return 0;
@@ -337,9 +320,9 @@
   if(verbosity > 3){
 
    for(uword i = 0; i < y_sum_cases.size(); ++i){
-    Rcout << "   -- For column " << i << ": ";
-    Rcout << y_sum_cases[i] << " cases, ";
-    Rcout << y_sum_ctrls[i] << " controls (unweighted)" << std::endl;
+    console() << "   -- For column " << i << ": ";
+    console() << y_sum_cases[i] << " cases, ";
+    console() << y_sum_ctrls[i] << " controls (unweighted)" << std::endl;
    }
   }
 
@@ -361,7 +344,7 @@
   if(counter == 0){
 
    if(verbosity > 3){
-    Rcout << "   -- No y columns are splittable" << std::endl << std::endl;
+    console() << "   -- No y columns are splittable" << std::endl << std::endl;
    }
 
    return counter;
@@ -370,7 +353,7 @@
 
   if(verbosity > 3){
    for(auto &i : splittable_y_cols){
-    Rcout << "   -- Y column " << i << " is splittable" << std::endl;
+    console() << "   -- Y column " << i << " is splittable" << std::endl;
    }
   }
 
@@ -394,7 +377,7 @@
   }
 
   if(verbosity > 3){
-   Rcout << "   -- Most splittable Y column: " << y_col_split << std::endl;
+   console() << "   -- Most splittable Y column: " << y_col_split << std::endl;
   }
 
   // glmnet can handle higher dimension x,
@@ -413,16 +396,35 @@
 
  }
 
+ void TreeClassification::write_binary_leaves(ForestFileWriter& file) const {
+
+  file.write_vecs(leaf_pred_prob);
+
+ }
+
+ double TreeClassification::compute_leaf_bytes() const {
+
+  double result = Tree::compute_leaf_bytes();
+
+  for(auto& leaf : leaf_pred_prob){
+   result += sizeof(arma::vec) + leaf.n_elem * sizeof(double);
+  }
+
+  return(result);
+
+ }
+
  uword TreeClassification::get_n_col_vi(){
 
   return(n_class);
 
  }
 
- void TreeClassification::predict_value_vi(mat& pred_values){
+ void TreeClassification::predict_value_vi(uvec& leaves,
+                                           mat& pred_values) const {
 
   for(uword i = 0; i < pred_values.n_rows; ++i){
-   pred_values.row(i) = leaf_pred_prob[pred_leaf[i]].t();
+   pred_values.row(i) = leaf_pred_prob[leaves[i]].t();
   }
 
  }
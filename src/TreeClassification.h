@@ -29,24 +29,30 @@
 
   TreeClassification(arma::uword n_obs,
                      arma::uword n_class,
-                     arma::uvec& rows_oobag,
-                     std::vector<double>& cutpoint,
-                     std::vector<arma::uword>& child_left,
-                     std::vector<arma::vec>& coef_values,
-                     std::vector<arma::uvec>& coef_indices,
-                     std::vector<arma::vec>& leaf_pred_prob,
-                     std::vector<double>& leaf_summary);
+                     arma::uvec rows_oobag,
+                     std::vector<double> cutpoint,
+                     std::vector<arma::uword> child_left,
+                     std::vector<arma::vec> coef_values,
+                     std::vector<arma::uvec> coef_indices,
+                     std::vector<arma::vec> leaf_pred_prob,
+                     std::vector<double> leaf_summary);
 
   void resize_leaves(arma::uword new_size) override;
 
+  void init_split_sums() override;
+
+  void move_split_sums(arma::uword row) override;
+
   double compute_split_score() override;
 
   void sprout_leaf_internal(arma::uword node_id) override;
 
-  arma::uword predict_value_internal(arma::uvec& pred_leaf_sort,
+  arma::uword predict_value_internal(const arma::uvec& leaf_ids,
+                                     const arma::uvec& leaf_bounds,
+                                     const arma::uvec& rows_grouped,
                                      arma::mat& pred_output,
                                      PredType pred_type,
-                                     bool oobag) override;
+                                     bool oobag) const override;
 
   arma::uword find_safe_mtry() override;
   arma::uword find_safe_mtry_binary();
@@ -58,9 +64,14 @@
   arma::mat glmnet_fit() override;
   arma::mat user_fit() override;
 
+  void write_binary_leaves(ForestFileWriter& file) const override;
+
+  double compute_leaf_bytes() const override;
+
   uword get_n_col_vi() override;
 
-  void predict_value_vi(arma::mat& pred_values) override;
+  void predict_value_vi(arma::uvec& leaves,
+                        arma::mat& pred_values) const override;
 
   std::vector<arma::vec>& get_leaf_pred_prob(){
    return(leaf_pred_prob);
@@ -72,6 +83,10 @@
   arma::uvec splittable_y_cols;
   arma::uword y_col_split;
 
+  // weights and weighted counts of y_col_split in the node and in
+  // the left node of the current cut (see Tree::find_best_cut)
+  double w_node_sum, y_node_sum, w_left_sum, y_left_sum;
+
   // prob holds the predicted prob for each class
   std::vector<arma::vec> leaf_pred_prob;
   // summary (see Tree.h) holds class vote
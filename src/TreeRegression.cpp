@@ -4,29 +4,33 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "TreeRegression.h"
 #include "Coxph.h"
 #include "utility.h"
 // #include "NodeSplitStats.h"
 
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
  TreeRegression::TreeRegression() { }
 
  TreeRegression::TreeRegression(arma::uword n_obs,
-                                arma::uvec& rows_oobag,
-                                std::vector<double>& cutpoint,
-                                std::vector<arma::uword>& child_left,
-                                std::vector<arma::vec>& coef_values,
-                                std::vector<arma::uvec>& coef_indices,
-                                std::vector<arma::vec>& leaf_pred_prob,
-                                std::vector<double>& leaf_summary) :
- Tree(rows_oobag, cutpoint, child_left, coef_values, coef_indices, leaf_summary),
- leaf_pred_prob(leaf_pred_prob){
+                                arma::uvec rows_oobag,
+                                std::vector<double> cutpoint,
+                                std::vector<arma::uword> child_left,
+                                std::vector<arma::vec> coef_values,
+                                std::vector<arma::uvec> coef_indices,
+                                std::vector<arma::vec> leaf_pred_prob,
+                                std::vector<double> leaf_summary) :
+ Tree(std::move(rows_oobag),
+      std::move(cutpoint),
+      std::move(child_left),
+      std::move(coef_values),
+      std::move(coef_indices),
+      std::move(leaf_summary)),
+ leaf_pred_prob(std::move(leaf_pred_prob)){
 
   find_rows_inbag(n_obs);
 
@@ -40,18 +44,47 @@
  }
 
 
+ void TreeRegression::init_split_sums(){
+
+  w_node_sum = sum(w_node);
+
+  y_node_mean = (y_node.t() * w_node) / w_node_sum;
+  y_node_sum.set_size(y_node.n_cols);
+  y_left_sum.zeros(y_node.n_cols);
+
+  for(uword i = 0; i < y_node.n_cols; i++){
+   y_node_sum[i] = dot(y_node.col(i) - y_node_mean[i], w_node);
+  }
+
+  w_left_sum = 0;
+
+ }
+
+ void TreeRegression::move_split_sums(arma::uword row){
+
+  w_left_sum += w_node[row];
+
+  for(uword i = 0; i < y_node.n_cols; i++){
+   y_left_sum[i] += w_node[row] * (y_node.at(row, i) - y_node_mean[i]);
+  }
+
+ }
+
  double TreeRegression::compute_split_score(){
 
   double result=0;
 
+  double w_right_sum = w_node_sum - w_left_sum;
+
   switch (split_rule) {
 
   case SPLIT_VARIANCE: {
 
    for(uword i = 0; i < y_node.n_cols; i++){
-   vec y_i = y_node.unsafe_col(i);
-   result += compute_var_reduction(y_i, w_node, g_node);
-  }
+    result += compute_var_reduction(w_left_sum, y_left_sum[i],
+                                    w_right_sum,
+                                    y_node_sum[i] - y_left_sum[i]);
+   }
 
    result /= y_node.n_cols;
    break;
@@ -59,7 +92,7 @@
   }
 
   default:
-   Rcpp::stop("invalid split rule");
+   stop("invalid split rule");
    break;
 
   }
@@ -110,34 +143,29 @@
  }
 
  arma::uword TreeRegression::predict_value_internal(
-   arma::uvec& pred_leaf_sort,
+   const arma::uvec& leaf_ids,
+   const arma::uvec& leaf_bounds,
+   const arma::uvec& rows_grouped,
    arma::mat& pred_output,
    PredType pred_type,
    bool oobag
- ){
+ ) const {
 
   uword n_preds_made = 0;
 
-  if(pred_type == PRED_PROBABILITY){
-
-   for(auto& it : pred_leaf_sort){
-
-    uword leaf_id = pred_leaf[it];
-    if(leaf_id == max_nodes) break;
-    pred_output.row(it) += leaf_pred_prob[leaf_id].t();
-
-    n_preds_made++;
-
-   }
+  for(uword g = 0; g < leaf_ids.size(); ++g){
 
-  } else if(pred_type == PRED_MEAN){
+   uword leaf_id = leaf_ids[g];
 
-   for(auto& it : pred_leaf_sort){
+   for(uword r = leaf_bounds[g]; r < leaf_bounds[g+1]; ++r){
 
-    uword leaf_id = pred_leaf[it];
-    if(leaf_id == max_nodes) break;
+    uword row = rows_grouped[r];
 
-    pred_output.at(it, 0) += leaf_summary[leaf_id];
+    if(pred_type == PRED_PROBABILITY){
+     pred_output.row(row) += leaf_pred_prob[leaf_id].t();
+    } else if(pred_type == PRED_MEAN){
+     pred_output.at(row, 0) += leaf_summary[leaf_id];
+    }
 
     n_preds_made++;
 
@@ -156,9 +184,8 @@
   mat out = linreg_fit(x_node,
                        y_col,
                        w_node,
-                       lincomb_scale,
-                       lincomb_eps,
-                       lincomb_iter_max);
+                       fit_options,
+                       *wls_workspace);
 
   return(out);
 
@@ -166,39 +193,14 @@
 
  arma::mat TreeRegression::glmnet_fit(){
 
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_node);
-  NumericVector ww = wrap(w_node);
-
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
-
-  NumericMatrix beta_R = f_beta(xx, yy, ww,
-                                lincomb_alpha,
-                                lincomb_df_target);
-
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
-
-  return(beta);
+  // lincomb_alpha and lincomb_df_target are bound to the function
+  return(lincomb_function(x_node, y_node, w_node));
 
  }
 
  arma::mat TreeRegression::user_fit(){
 
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_node);
-  NumericVector ww = wrap(w_node);
-
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
-
-  NumericMatrix beta_R = f_beta(xx, yy, ww);
-
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
-
-  return(beta);
+  return(lincomb_function(x_node, y_node, w_node));
 
  }
 
@@ -211,17 +213,7 @@
 
    vec preds_vec = preds.unsafe_col(0);
 
-   NumericMatrix y_wrap = wrap(y_oobag);
-   NumericVector w_wrap = wrap(w_oobag);
-   NumericVector p_wrap = wrap(preds_vec);
-
-   // initialize function from tree object
-   // (Functions can't be stored in C++ classes, but RObjects can)
-   Function f_oobag = as<Function>(oobag_R_function);
-
-   NumericVector result_R = f_oobag(y_wrap, w_wrap, p_wrap);
-
-   return(result_R[0]);
+   return(oobag_eval_function(y_oobag, w_oobag, preds_vec));
 
   }
 
@@ -250,7 +242,7 @@
    double n = y_node.n_rows;
 
    if(verbosity > 3){
-    Rcout << "   -- N obs (unweighted): " << n << std::endl;
+    console() << "   -- N obs (unweighted): " << n << std::endl;
    }
 
    while (n / safer_mtry < 3){
@@ -266,14 +258,33 @@
 
  }
 
+ void TreeRegression::write_binary_leaves(ForestFileWriter& file) const {
+
+  file.write_vecs(leaf_pred_prob);
+
+ }
+
+ double TreeRegression::compute_leaf_bytes() const {
+
+  double result = Tree::compute_leaf_bytes();
+
+  for(auto& leaf : leaf_pred_prob){
+   result += sizeof(arma::vec) + leaf.n_elem * sizeof(double);
+  }
+
+  return(result);
+
+ }
+
  uword TreeRegression::get_n_col_vi(){
   return(1);
  }
 
- void TreeRegression::predict_value_vi(mat& pred_values){
+ void TreeRegression::predict_value_vi(uvec& leaves,
+                                       mat& pred_values) const {
 
   for(uword i = 0; i < pred_values.n_rows; ++i){
-   pred_values.at(i, 0) = leaf_summary[pred_leaf[i]];
+   pred_values.at(i, 0) = leaf_summary[leaves[i]];
   }
 
  }
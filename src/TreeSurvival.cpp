@@ -4,14 +4,14 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
+#include <algorithm>
 #include "TreeSurvival.h"
 #include "Coxph.h"
 #include "utility.h"
 // #include "NodeSplitStats.h"
 
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
@@ -26,24 +26,35 @@
   this->split_min_events = split_min_events;
   this->unique_event_times = unique_event_times;
   this->pred_horizon = pred_horizon;
+  this->n_leaf_values = 0;
 
  }
 
  TreeSurvival::TreeSurvival(arma::uword n_obs,
-                            arma::uvec& rows_oobag,
-                            std::vector<double>& cutpoint,
-                            std::vector<arma::uword>& child_left,
-                            std::vector<arma::vec>& coef_values,
-                            std::vector<arma::uvec>& coef_indices,
-                            std::vector<arma::vec>& leaf_pred_indx,
-                            std::vector<arma::vec>& leaf_pred_prob,
-                            std::vector<arma::vec>& leaf_pred_chaz,
-                            std::vector<double>& leaf_summary,
+                            arma::uvec rows_oobag,
+                            std::vector<double> cutpoint,
+                            std::vector<arma::uword> child_left,
+                            std::vector<arma::vec> coef_values,
+                            std::vector<arma::uvec> coef_indices,
+                            arma::uvec leaf_pred_offset,
+                            arma::Col<arma::u32> leaf_pred_indx,
+                            arma::vec leaf_pred_prob,
+                            arma::vec leaf_pred_chaz,
+                            std::vector<double> leaf_summary,
+                            arma::vec* unique_event_times,
                             arma::vec* pred_horizon) :
- Tree(rows_oobag, cutpoint, child_left, coef_values, coef_indices, leaf_summary),
- leaf_pred_indx(leaf_pred_indx),
- leaf_pred_prob(leaf_pred_prob),
- leaf_pred_chaz(leaf_pred_chaz),
+ Tree(std::move(rows_oobag),
+      std::move(cutpoint),
+      std::move(child_left),
+      std::move(coef_values),
+      std::move(coef_indices),
+      std::move(leaf_summary)),
+ leaf_pred_offset(std::move(leaf_pred_offset)),
+ leaf_pred_indx(std::move(leaf_pred_indx)),
+ leaf_pred_prob(std::move(leaf_pred_prob)),
+ leaf_pred_chaz(std::move(leaf_pred_chaz)),
+ n_leaf_values(this->leaf_pred_prob.n_elem),
+ unique_event_times(unique_event_times),
  pred_horizon(pred_horizon){
 
   find_rows_inbag(n_obs);
@@ -52,11 +63,29 @@
 
  void TreeSurvival::resize_leaves(arma::uword new_size) {
 
-  leaf_pred_indx.resize(new_size);
-  leaf_pred_prob.resize(new_size);
-  leaf_pred_chaz.resize(new_size);
   leaf_summary.resize(new_size);
 
+  if(leaf_pred_offset.is_empty()){
+   // no leaves have been sprouted yet
+   leaf_pred_offset.zeros(new_size + 1);
+   n_leaf_values = 0;
+   return;
+  }
+
+  // leaves are sprouted in ascending order of node id, so a node that
+  // isn't a leaf starts (and ends) where the node before it ends.
+  for(uword i = 1; i <= new_size; ++i){
+   if(leaf_pred_offset[i] < leaf_pred_offset[i-1]){
+    leaf_pred_offset[i] = leaf_pred_offset[i-1];
+   }
+  }
+
+  leaf_pred_offset.resize(new_size + 1);
+
+  leaf_pred_indx.resize(n_leaf_values);
+  leaf_pred_prob.resize(n_leaf_values);
+  leaf_pred_chaz.resize(n_leaf_values);
+
  }
 
  double TreeSurvival::compute_max_leaves(){
@@ -127,9 +156,9 @@
    uvec rows_event = find(y_print.col(1) == 1);
    x_print = x_print.rows(rows_event);
 
-   Rcout << "  --- Column " << j << " was sampled but ";
-   Rcout << " unique values of column " << j << " are ";
-   Rcout << unique(x_print.col(j)) << std::endl;
+   console() << "  --- Column " << j << " was sampled but ";
+   console() << " unique values of column " << j << " are ";
+   console() << unique(x_print.col(j)) << std::endl;
    // # nocov end
   }
 
@@ -137,6 +166,17 @@
 
  }
 
+ void TreeSurvival::prep_node_internal(){
+
+  // rows of data in this node (rows_node indexes the inbag rows)
+  uvec rows = rows_inbag(rows_node);
+
+  uvec y_rank_node = data->get_y_rank()(rows);
+
+  find_time_groups(y_node, w_node, y_rank_node, node_groups);
+
+ }
+
  bool TreeSurvival::is_node_splittable_internal(){
 
   double n_risk = sum(w_node);
@@ -179,11 +219,11 @@
 
      if(verbosity > 2){
       // # nocov start
-      Rcout << std::endl;
-      Rcout << "  -- lower cutpoint: "        << lincomb(*it) << std::endl;
-      Rcout << "     - n_events, left node: " << n_events << std::endl;
-      Rcout << "     - n_risk, left node:   " << n_risk   << std::endl;
-      Rcout << std::endl;
+      console() << std::endl;
+      console() << "  -- lower cutpoint: "        << lincomb(*it) << std::endl;
+      console() << "     - n_events, left node: " << n_events << std::endl;
+      console() << "     - n_risk, left node:   " << n_risk   << std::endl;
+      console() << std::endl;
       // # nocov end
      }
 
@@ -201,7 +241,7 @@
 
    if(verbosity > 2){
     // # nocov start
-    Rcout << "   -- Could not find a valid cut-point" << std::endl;
+    console() << "   -- Could not find a valid cut-point" << std::endl;
     // # nocov end
    }
 
@@ -238,11 +278,11 @@
 
      if(verbosity > 2){
       // # nocov start
-      Rcout << std::endl;
-      Rcout << "  -- upper cutpoint: " << lincomb(*it) << std::endl;
-      Rcout << "     - n_events, right node: " << n_events    << std::endl;
-      Rcout << "     - n_risk, right node:   " << n_risk      << std::endl;
-      Rcout << std::endl;
+      console() << std::endl;
+      console() << "  -- upper cutpoint: " << lincomb(*it) << std::endl;
+      console() << "     - n_events, right node: " << n_events    << std::endl;
+      console() << "     - n_risk, right node:   " << n_risk      << std::endl;
+      console() << std::endl;
       // # nocov end
      }
 
@@ -263,7 +303,7 @@
 
    if(verbosity > 2) {
     // # nocov start
-    Rcout << "Could not find valid cut-points" << std::endl;
+    console() << "Could not find valid cut-points" << std::endl;
     // # nocov end
    }
 
@@ -325,17 +365,17 @@
   switch (split_rule) {
 
   case SPLIT_LOGRANK: {
-   result = compute_logrank(y_node, w_node, g_node);
+   result = compute_logrank(y_node, w_node, g_node, node_groups);
    break;
   }
 
   case SPLIT_CONCORD: {
-   result = compute_cstat_surv(y_node, w_node, g_node, true);
+   result = compute_cstat_surv(y_node, w_node, g_node, node_groups, true);
    break;
   }
 
   default:
-   Rcpp::stop("invalid split rule");
+   stop("invalid split rule");
    break;
 
   }
@@ -346,159 +386,129 @@
 
  void TreeSurvival::sprout_leaf_internal(uword node_id){
 
-  // reserve as much size as could be needed (probably more)
-  mat leaf_data(y_node.n_rows, 3);
-
-  uword person = 0;
+  const TimeGroups& groups = node_groups;
 
-  // find the first unique event time
-  while(y_node.at(person, 1) == 0 && person < y_node.n_rows){
-   person++;
-  }
-
-  // person corresponds to first event or last censor time
-  leaf_data.at(0, 0) = y_node.at(person, 0);
-
-  // if no events in this node:
-  if(person == y_node.n_rows){
-
-   vec temp_surv(1, fill::ones);
-   vec temp_chf(1, fill::zeros);
-
-   leaf_pred_indx[node_id] = leaf_data.col(0);
-   leaf_pred_prob[node_id] = temp_surv;
-   leaf_pred_chaz[node_id] = temp_chf;
-   leaf_summary[node_id] = 0.0;
-
-   return;
+  uword n_groups = groups.rank.n_elem;
 
+  // each tie group with an event adds one value to the leaf, so
+  // n_groups is enough room. Buffers grow geometrically and are
+  // trimmed once the tree is fully grown (see resize_leaves)
+  if(n_leaf_values + n_groups > leaf_pred_prob.n_elem){
+   uword capacity = 2 * (n_leaf_values + n_groups);
+   leaf_pred_indx.resize(capacity);
+   leaf_pred_prob.resize(capacity);
+   leaf_pred_chaz.resize(capacity);
   }
 
-  double temp_time = y_node.at(person, 0);
-
-  uword i = 1;
-
-  // find the rest of the unique event times
-  for( ; person < y_node.n_rows; person++){
-
-   if(temp_time != y_node.at(person, 0) && y_node.at(person, 1) == 1){
-
-    leaf_data.at(i, 0) = y_node.at(person,0);
-    temp_time = y_node.at(person, 0);
-    i++;
-
-   }
-
-  }
-
-  leaf_data.resize(i, 3);
-
-  // reset for kaplan meier loop
-  person = 0; i = 0;
+  // kaplan meier and nelson aalen estimates, one tie group at a time
   double n_risk = sum(w_node);
   double temp_surv = 1.0;
   double temp_haz = 0.0;
 
-  do {
-
-   double n_events   = 0;
-   double n_risk_sub = 0;
-   temp_time = y_node.at(person, 0);
-
-   while(y_node.at(person, 0) == temp_time){
+  // expected mortality is the leaf's cumulative hazard summed over
+  // the forest's event times, where the hazard at each event time is
+  // the first leaf value at or after it. Each leaf value covers the
+  // event times since the previous one, so the sum is accumulated in
+  // the same pass rather than by walking every event time.
+  double mortality = 0.0;
+  uword n_times_covered = 0;
 
-    n_risk_sub += w_node.at(person);
-    n_events += y_node.at(person, 1) * w_node.at(person);
+  uword i = n_leaf_values;
 
-    if(person == y_node.n_rows-1) break;
+  for(uword k = 0; k < n_groups; ++k){
 
-    person++;
-
-   }
+   double n_events = groups.events[k];
 
    // only do km if a death was observed
-
    if(n_events > 0){
 
     temp_surv = temp_surv * (n_risk - n_events) / n_risk;
 
     temp_haz = temp_haz + n_events / n_risk;
 
-    leaf_data.at(i, 1) = temp_surv;
-    leaf_data.at(i, 2) = temp_haz;
+    // ranks of event times are odd (see find_time_ranks)
+    uword time_index = (groups.rank[k] - 1) / 2;
+
+    leaf_pred_indx[i] = time_index;
+    leaf_pred_prob[i] = temp_surv;
+    leaf_pred_chaz[i] = temp_haz;
     i++;
 
+    mortality += temp_haz * (time_index + 1 - n_times_covered);
+    n_times_covered = time_index + 1;
+
    }
 
-   n_risk -= n_risk_sub;
+   n_risk -= groups.weight[k];
+
+  }
+
+  // if no events in this node, the leaf has no values, i.e.,
+  // survival stays at 1 and cumulative hazard stays at 0.
+  if(i > n_leaf_values){
+   // event times after the last leaf value use its hazard
+   mortality += temp_haz * ((*unique_event_times).n_elem - n_times_covered);
+  }
 
-  } while (i < leaf_data.n_rows);
+  // the leaf's start is written here too, so that its values can be
+  // read (e.g., by get_leaf_data) before resize_leaves fills in the
+  // offsets of nodes that are not leaves
+  leaf_pred_offset[node_id] = n_leaf_values;
+  leaf_pred_offset[node_id + 1] = i;
 
+  n_leaf_values = i;
+  leaf_summary[node_id] = mortality;
 
   if(verbosity > 3){
    // # nocov start
    mat tmp_mat = join_horiz(y_node, w_node);
+   mat leaf_data = get_leaf_data(node_id);
    print_mat(tmp_mat, "time & status & weights in this node", 10, 10);
    print_mat(leaf_data, "leaf_data (showing up to 5 rows)", 5, 5);
    // # nocov end
   }
 
-  leaf_pred_indx[node_id] = leaf_data.col(0);
-  leaf_pred_prob[node_id] = leaf_data.col(1);
-  leaf_pred_chaz[node_id] = leaf_data.col(2);
-  leaf_summary[node_id] = compute_mortality(leaf_data);
-
  }
 
- double TreeSurvival::compute_mortality(arma::mat& leaf_data){
+ arma::mat TreeSurvival::get_leaf_data(arma::uword leaf_id) const {
 
-  double result = 0;
-  uword i=0, j=0;
+  uword start = leaf_pred_offset[leaf_id];
+  uword n_values = leaf_pred_offset[leaf_id + 1] - start;
 
-  for( ; i < (*unique_event_times).size(); i++){
+  mat leaf_data(n_values, 3);
 
+  for(uword i = 0; i < n_values; ++i){
+   leaf_data.at(i, 0) = (*unique_event_times)[leaf_pred_indx[start + i]];
+   leaf_data.at(i, 1) = leaf_pred_prob[start + i];
+   leaf_data.at(i, 2) = leaf_pred_chaz[start + i];
+  }
 
-   while((*unique_event_times)[i] > leaf_data.at(j, 0) &&
-          j < (leaf_data.n_rows-1)) {
-    j++;
-   }
+  return(leaf_data);
 
-   result += leaf_data.at(j, 2);
+ }
 
-  }
+ arma::uvec TreeSurvival::find_pred_horizon_ranks() const {
 
-  return(result);
+  const vec& event_times = *unique_event_times;
 
- }
+  uvec result((*pred_horizon).size());
 
- // double TreeSurvival::compute_mortality(arma::mat& leaf_data){
- //
- //  double result = 0;
- //  uword i=0, j=0;
- //
- //  for( ; i < (*unique_event_times).size(); i++){
- //
- //   if((*unique_event_times)[i] >= leaf_data.at(j, 0) &&
- //      j < (leaf_data.n_rows-1)) {j++;}
- //
- //   result += leaf_data.at(j, 2);
- //
- //  }
- //
- //  return(result);
- //
- // }
+  for(uword j = 0; j < result.size(); ++j){
 
- arma::uword TreeSurvival::predict_value_internal(
-   arma::uvec& pred_leaf_sort,
-   arma::mat& pred_output,
-   PredType pred_type,
-   bool oobag
- ){
+   result[j] = std::upper_bound(event_times.begin(),
+                                event_times.end(),
+                                (*pred_horizon)[j]) - event_times.begin();
 
-  uvec::iterator it = pred_leaf_sort.begin();
+  }
+
+  return(result);
 
-  uword leaf_id = pred_leaf[*it];
+ }
+
+ void TreeSurvival::predict_leaf_value(arma::uword leaf_id,
+                                       PredType pred_type,
+                                       const arma::uvec& pred_horizon_ranks,
+                                       arma::vec& temp_vec) const {
 
   // default for risk or survival at time 0
   double pred_t0 = 1;
@@ -509,185 +519,101 @@
    pred_t0 = 0;
   }
 
-  uword i, j;
-
-  uword n_preds_made = 0;
-
-  vec leaf_times, leaf_values;
-
-  vec temp_vec((*pred_horizon).size());
-
-  double temp_dbl = pred_t0;
-  bool break_loop = false;
-  bool do_timeloop = (pred_type == PRED_RISK ||
-                      pred_type == PRED_SURVIVAL ||
-                      pred_type == PRED_CHAZ);
+  uword start = leaf_pred_offset[leaf_id];
+  uword end = leaf_pred_offset[leaf_id + 1];
 
+  switch (pred_type) {
 
-  for(; ;) {
+  case PRED_MORTALITY: {
 
-   // copies of leaf data using same aux memory
-   leaf_times = vec(leaf_pred_indx[leaf_id].begin(),
-                    leaf_pred_indx[leaf_id].size(),
-                    false);
+   temp_vec.fill(leaf_summary[leaf_id]);
 
-   switch (pred_type) {
-
-   case PRED_RISK: case PRED_SURVIVAL: {
+   return;
 
-    leaf_values = vec(leaf_pred_prob[leaf_id].begin(),
-                      leaf_pred_prob[leaf_id].size(),
-                      false);
+  } case PRED_TIME: {
 
-    break;
+   // restricted mean survival time
+   double result = 0;
+   double time_prev = 0;
 
-   }
+   for(uword i = start; i < end; i++){
 
-   case PRED_CHAZ: {
+    double time = (*unique_event_times)[leaf_pred_indx[i]];
 
-    leaf_values = vec(leaf_pred_chaz[leaf_id].begin(),
-                      leaf_pred_chaz[leaf_id].size(),
-                      false);
+    result += (time - time_prev) * leaf_pred_prob[i];
 
-    break;
+    time_prev = time;
 
    }
 
-   case PRED_MORTALITY: {
-
-    temp_vec.fill(leaf_summary[leaf_id]);
+   temp_vec.fill(result);
 
-    break;
-
-   } case PRED_TIME: {
-
-    // restricted mean survival time
+   return;
 
-    leaf_values = vec(leaf_pred_prob[leaf_id].begin(),
-                      leaf_pred_prob[leaf_id].size(),
-                      false);
+  }
 
-    double result = leaf_times[0] * leaf_values[0];
+  case PRED_RISK: case PRED_SURVIVAL: case PRED_CHAZ: {
 
-    for(uword i = 1; i < leaf_times.size(); i++){
+   break;
 
-     result += (leaf_times[i] - leaf_times[i-1]) * leaf_values[i];
+  }
 
-    }
+  default:
+   console() << "Invalid pred type; R will crash";
+   return;
 
-    temp_vec.fill(result);
+  }
 
-    break;
+  const vec& leaf_values = (pred_type == PRED_CHAZ) ?
+   leaf_pred_chaz : leaf_pred_prob;
 
-   }
+  // don't reset i in the loop b/c leaf times and horizons ascend
+  uword i = start;
 
-   default:
-    Rcout << "Invalid pred type; R will crash";
-    break;
+  for(uword j = 0; j < pred_horizon_ranks.size(); j++){
 
+   // leaf times <= the current prediction time are the ones with
+   // an index below its rank among the unique event times, and the
+   // prediction is anchored to the last of them.
+   while(i < end && leaf_pred_indx[i] < pred_horizon_ranks[j]){
+    i++;
    }
 
-   // don't reset i in the loop b/c leaf_times ascend
-   i = 0;
-
-   if(do_timeloop){
-
-    for(j = 0; j < (*pred_horizon).size(); j++){
-
-     // t is the current prediction time
-     double t = (*pred_horizon)[j];
-
-     // if t < t', where t' is the max time in this leaf,
-     // then we may find a time t* such that t* < t < t'.
-     // If so, prediction should be anchored to t*.
-     // But, there may be multiple t* < t, and we want to
-     // find the largest t* that is < t, so we find the
-     // first t** > t and assign t* to be whatever came
-     // right before t**.
-     if(t < leaf_times.back()){
-
-      for(; i < leaf_times.size(); i++){
-
-       // we found t**
-       if (leaf_times[i] > t){
-
-        if(i == 0)
-         // first leaf event occurred after prediction time
-         temp_dbl = pred_t0;
-        else
-         // t* is the time value just before t**, so use i-1
-         temp_dbl = leaf_values[i-1];
-
-        break;
-
-       } else if (leaf_times[i] == t){
-        // pred_horizon just happens to equal a leaf time
-        temp_dbl = leaf_values[i];
-
-        break;
-
-       }
-
-      }
+   // if the first leaf event occurred after prediction time,
+   // use the value at time 0
+   temp_vec[j] = (i == start) ? pred_t0 : leaf_values[i-1];
 
-     } else {
-      // if t > t' use the last recorded prediction
-      temp_dbl = leaf_values.back();
-
-     }
-
-     temp_vec[j] = temp_dbl;
-
-    }
+  }
 
-   }
+  if(pred_type == PRED_RISK) temp_vec = 1 - temp_vec;
 
-   if(pred_type == PRED_RISK) temp_vec = 1 - temp_vec;
+ }
 
-   pred_output.row(*it) += temp_vec.t();
-   n_preds_made++;
+ arma::uword TreeSurvival::predict_value_internal(
+   const arma::uvec& leaf_ids,
+   const arma::uvec& leaf_bounds,
+   const arma::uvec& rows_grouped,
+   arma::mat& pred_output,
+   PredType pred_type,
+   bool oobag
+ ) const {
 
-   // Rcout << "npreds: " << n_preds_made << ", ";
-   // Rcout << "*it: " << (*it) << std::endl;
+  uword n_preds_made = 0;
 
-   // in case the last obs has a unique leaf assignment
-   if(it == pred_leaf_sort.end()-1) break;
+  vec temp_vec((*pred_horizon).size());
 
-   for(; ;){
+  uvec pred_horizon_ranks = find_pred_horizon_ranks();
 
-    ++it;
-    if (it == pred_leaf_sort.end()-1){
-     // we've reached the final value of pred_leaf
-     // check to see if it's the same leaf as the obs before:
-     if (leaf_id == pred_leaf[*it]){
-      // if it is, add the value to the pred_output, and be done
-      pred_output.row(*it) += temp_vec.t();
-      n_preds_made++;
-      break_loop = true;
-      break;
-     }
+  for(uword g = 0; g < leaf_ids.size(); ++g){
 
-    }
+   // computed once per leaf, then added to each row in the leaf
+   predict_leaf_value(leaf_ids[g], pred_type, pred_horizon_ranks, temp_vec);
 
-    // put this predicted value into the predicted output
-    // until we get to a new leaf id
-    if(leaf_id != pred_leaf[*it]) break;
-
-    pred_output.row(*it) += temp_vec.t();
+   for(uword r = leaf_bounds[g]; r < leaf_bounds[g+1]; ++r){
+    pred_output.row(rows_grouped[r]) += temp_vec.t();
     n_preds_made++;
-
-    // Rcout << "npreds: " << n_preds_made << ", ";
-    // Rcout << "*it (inner loop): " << (*it) << std::endl;
-
    }
 
-   if(break_loop) break;
-
-   leaf_id = pred_leaf(*it);
-
-   // case 3: we've finished out-of-bag predictions
-   if(leaf_id == max_nodes) break;
-
   }
 
   return(n_preds_made);
@@ -700,17 +626,7 @@
 
    vec preds_vec = preds.unsafe_col(0);
 
-   NumericMatrix y_wrap = wrap(y_oobag);
-   NumericVector w_wrap = wrap(w_oobag);
-   NumericVector p_wrap = wrap(preds_vec);
-
-   // initialize function from tree object
-   // (Functions can't be stored in C++ classes, but RObjects can)
-   Function f_oobag = as<Function>(oobag_R_function);
-
-   NumericVector result_R = f_oobag(y_wrap, w_wrap, p_wrap);
-
-   return(result_R[0]);
+   return(oobag_eval_function(y_oobag, w_oobag, preds_vec));
 
   }
 
@@ -722,9 +638,7 @@
 
  arma::mat TreeSurvival::glm_fit(){
 
-  mat out = coxph_fit(x_node, y_node, w_node,
-                      lincomb_scale, lincomb_ties_method,
-                      lincomb_eps, lincomb_iter_max);
+  mat out = coxph_fit(x_node, y_node, w_node, node_groups, fit_options);
 
   return(out);
 
@@ -732,39 +646,33 @@
 
  arma::mat TreeSurvival::glmnet_fit(){
 
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_node);
-  NumericVector ww = wrap(w_node);
-
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
+  // lincomb_alpha and lincomb_df_target are bound to the function
+  return(lincomb_function(x_node, y_node, w_node));
 
-  NumericMatrix beta_R = f_beta(xx, yy, ww,
-                                lincomb_alpha,
-                                lincomb_df_target);
+ }
 
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
+ arma::mat TreeSurvival::user_fit(){
 
-  return(beta);
+  return(lincomb_function(x_node, y_node, w_node));
 
  }
 
- arma::mat TreeSurvival::user_fit(){
-
-  NumericMatrix xx = wrap(x_node);
-  NumericMatrix yy = wrap(y_node);
-  NumericVector ww = wrap(w_node);
+ void TreeSurvival::write_binary_leaves(ForestFileWriter& file) const {
 
-  // initialize function from tree object
-  // (Functions can't be stored in C++ classes, but RObjects can)
-  Function f_beta = as<Function>(lincomb_R_function);
+  file.write_uvec(leaf_pred_offset);
+  file.write_u32_vec(leaf_pred_indx);
+  file.write_vec(leaf_pred_prob);
+  file.write_vec(leaf_pred_chaz);
 
-  NumericMatrix beta_R = f_beta(xx, yy, ww);
+ }
 
-  mat beta = mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol(), false);
+ double TreeSurvival::compute_leaf_bytes() const {
 
-  return(beta);
+  return(Tree::compute_leaf_bytes() +
+         leaf_pred_offset.n_elem * sizeof(uword) +
+         leaf_pred_indx.n_elem * sizeof(arma::u32) +
+         leaf_pred_prob.n_elem * sizeof(double) +
+         leaf_pred_chaz.n_elem * sizeof(double));
 
  }
 
@@ -772,10 +680,11 @@
   return(1);
  }
 
- void TreeSurvival::predict_value_vi(mat& pred_values){
+ void TreeSurvival::predict_value_vi(uvec& leaves,
+                                     mat& pred_values) const {
 
   for(uword i = 0; i < pred_values.n_rows; ++i){
-   pred_values.at(i, 0) = leaf_summary[pred_leaf[i]];
+   pred_values.at(i, 0) = leaf_summary[leaves[i]];
   }
 
  }
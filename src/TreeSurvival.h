@@ -31,15 +31,17 @@
                arma::vec* pred_horizon);
 
   TreeSurvival(arma::uword n_obs,
-               arma::uvec& rows_oobag,
-               std::vector<double>& cutpoint,
-               std::vector<arma::uword>& child_left,
-               std::vector<arma::vec>& coef_values,
-               std::vector<arma::uvec>& coef_indices,
-               std::vector<arma::vec>& leaf_pred_indx,
-               std::vector<arma::vec>& leaf_pred_prob,
-               std::vector<arma::vec>& leaf_pred_chaz,
-               std::vector<double>& leaf_summary,
+               arma::uvec rows_oobag,
+               std::vector<double> cutpoint,
+               std::vector<arma::uword> child_left,
+               std::vector<arma::vec> coef_values,
+               std::vector<arma::uvec> coef_indices,
+               arma::uvec leaf_pred_offset,
+               arma::Col<arma::u32> leaf_pred_indx,
+               arma::vec leaf_pred_prob,
+               arma::vec leaf_pred_chaz,
+               std::vector<double> leaf_summary,
+               arma::vec* unique_event_times,
                arma::vec* pred_horizon);
 
   void resize_leaves(arma::uword new_size) override;
@@ -48,34 +50,58 @@
 
   bool is_col_splittable(arma::uword j) override;
 
+  void prep_node_internal() override;
+
   bool is_node_splittable_internal() override;
 
   void find_all_cuts() override;
 
   double compute_split_score() override;
 
-  double compute_mortality(arma::mat& leaf_data);
-
   void sprout_leaf_internal(uword node_id) override;
 
+  void write_binary_leaves(ForestFileWriter& file) const override;
+
+  double compute_leaf_bytes() const override;
+
   uword get_n_col_vi() override;
 
-  void predict_value_vi(arma::mat& pred_values) override;
+  void predict_value_vi(arma::uvec& leaves,
+                        arma::mat& pred_values) const override;
+
+  // the number of unique event times <= each prediction horizon
+  arma::uvec find_pred_horizon_ranks() const;
 
-  arma::uword predict_value_internal(arma::uvec& pred_leaf_sort,
+  // fills temp_vec with the prediction for one leaf,
+  // one value per prediction horizon
+  void predict_leaf_value(arma::uword leaf_id,
+                          PredType pred_type,
+                          const arma::uvec& pred_horizon_ranks,
+                          arma::vec& temp_vec) const;
+
+  arma::uword predict_value_internal(const arma::uvec& leaf_ids,
+                                     const arma::uvec& leaf_bounds,
+                                     const arma::uvec& rows_grouped,
                                      arma::mat& pred_output,
                                      PredType pred_type,
-                                     bool oobag) override;
+                                     bool oobag) const override;
+
+  // event times, survival, and cumulative hazard of one leaf
+  arma::mat get_leaf_data(arma::uword leaf_id) const;
+
+  arma::uvec& get_leaf_pred_offset(){
+   return(leaf_pred_offset);
+  }
 
-  std::vector<arma::vec>& get_leaf_pred_indx(){
+  arma::Col<arma::u32>& get_leaf_pred_indx(){
    return(leaf_pred_indx);
   }
 
-  std::vector<arma::vec>& get_leaf_pred_prob(){
+  arma::vec& get_leaf_pred_prob(){
    return(leaf_pred_prob);
   }
 
-  std::vector<arma::vec>& get_leaf_pred_chaz(){
+  arma::vec& get_leaf_pred_chaz(){
    return(leaf_pred_chaz);
   }
 
@@ -95,14 +121,26 @@
   arma::mat glmnet_fit() override;
   arma::mat user_fit() override;
 
-  // indx holds the times
-  std::vector<arma::vec> leaf_pred_indx;
+  // values of all leaves in the tree are stored back to back, and
+  // the values of leaf i are in [offset[i], offset[i+1]). Nodes that
+  // are not leaves have no values. This avoids the overhead of a
+  // separate vector for each node (most leaves hold a few values).
+  arma::uvec leaf_pred_offset;
+  // indx holds the times, as indices of unique_event_times
+  arma::Col<arma::u32> leaf_pred_indx;
   // prob holds the predicted survival
-  std::vector<arma::vec> leaf_pred_prob;
+  arma::vec leaf_pred_prob;
   // chaz holds the cumulative hazard
-  std::vector<arma::vec> leaf_pred_chaz;
+  arma::vec leaf_pred_chaz;
   // summary (see Tree.h) holds total mortality
 
+  // number of values in use while leaves are sprouted
+  arma::uword n_leaf_values;
+
+  // tie groups of y_node, shared by the split scores, the cox
+  // model, and the leaf estimates of the current node
+  TimeGroups node_groups;
+
   // pointer to event times in forest
   arma::vec* unique_event_times;
 
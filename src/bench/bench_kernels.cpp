@@ -0,0 +1,499 @@
+/*-----------------------------------------------------------------------------
+ This file is part of aorsf.
+ Author: Byron C Jaeger
+ aorsf may be modified and distributed under the terms of the MIT license.
+#----------------------------------------------------------------------------*/
+
+// microbenchmarks for the kernels that dominate training and prediction
+//
+// @description each kernel runs on synthetic survival data at several
+//   sizes (rows, columns in a node, prediction horizons). A kernel is
+//   called until at least --min-time seconds have passed, and one
+//   line is written per kernel and size with the mean seconds per call
+//   and rows per second. Output is CSV (default) or JSON lines, so runs
+//   on different commits or machines can be compared by a script.
+//
+//   aorsf_bench [--max-rows N] [--min-time S] [--format=csv|json]
+//               [--filter TEXT]
+//
+//   Options can also be written as --name=value. --format only
+//   accepts csv or json; any other value is an error.
+//
+//   Sizes go from 1e3 rows up to --max-rows by factors of 10. The
+//   default is 1e6; 1e7 needs about 6 GB of memory. Kernels whose name
+//   does not contain --filter are skipped.
+
+#include "Coxph.h"
+#include "Data.h"
+#include "Telemetry.h"
+#include "TreeSurvival.h"
+#include "utility.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+ using namespace arma;
+ using namespace aorsf;
+
+ namespace {
+
+ struct BenchOptions {
+  uword max_rows = 1000000;
+  double min_time = 0.2;
+  bool json = false;
+  std::string filter;
+ };
+
+ struct BenchResult {
+  std::string kernel;
+  uword n_rows;
+  uword n_cols;
+  uword n_horizon;
+  uword n_reps;
+  double seconds;
+ };
+
+ // results are added here so that the compiler can't drop the calls
+ volatile double sink = 0;
+
+ void write_header(const BenchOptions& opts){
+  if(opts.json) return;
+  std::cout << "kernel,n_rows,n_cols,n_horizon,n_reps," <<
+   "seconds_per_call,rows_per_second" << std::endl;
+ }
+
+ void write_result(const BenchOptions& opts, const BenchResult& res){
+
+  double per_call = res.seconds / res.n_reps;
+  double rows_per_second = res.n_rows / per_call;
+
+  if(opts.json){
+   std::cout << "{\"kernel\":\"" << res.kernel << "\"" <<
+    ",\"n_rows\":" << res.n_rows <<
+    ",\"n_cols\":" << res.n_cols <<
+    ",\"n_horizon\":" << res.n_horizon <<
+    ",\"n_reps\":" << res.n_reps <<
+    ",\"seconds_per_call\":" << per_call <<
+    ",\"rows_per_second\":" << rows_per_second << "}" << std::endl;
+  } else {
+   std::cout << res.kernel << "," << res.n_rows << "," << res.n_cols <<
+    "," << res.n_horizon << "," << res.n_reps << "," << per_call <<
+    "," << rows_per_second << std::endl;
+  }
+
+ }
+
+ bool selected(const BenchOptions& opts, const std::string& kernel){
+  return(opts.filter.empty() || kernel.find(opts.filter) != std::string::npos);
+ }
+
+ // calls f once to warm up, then until min_time has passed
+ template <typename F>
+ void run_kernel(const BenchOptions& opts,
+                 const std::string& kernel,
+                 uword n_rows,
+                 uword n_cols,
+                 uword n_horizon,
+                 F f){
+
+  f();
+
+  BenchResult res = {kernel, n_rows, n_cols, n_horizon, 0, 0};
+
+  TimePoint start = time_now();
+
+  do {
+   f();
+   res.n_reps++;
+   res.seconds = seconds_since(start);
+  } while (res.seconds < opts.min_time);
+
+  write_result(opts, res);
+
+ }
+
+ // survival data sorted by time, as the R package passes it. Times
+ // are rounded so that there are ties, and about 30% are censored.
+ struct SurvData {
+  mat x;
+  mat y;
+  vec w;
+  vec beta;
+ };
+
+ SurvData make_surv_data(uword n_rows, uword n_cols){
+
+  SurvData d;
+
+  d.x.randn(n_rows, n_cols);
+
+  d.beta.set_size(n_cols);
+  for(uword j = 0; j < n_cols; ++j){
+   d.beta[j] = (j % 2 == 0 ? 1.0 : -1.0) / std::sqrt((double) n_cols);
+  }
+
+  vec eta = d.x * d.beta;
+
+  vec time_event = -log(randu<vec>(n_rows)) / exp(eta);
+  vec time_censor = -log(randu<vec>(n_rows)) / 0.4;
+
+  vec time = round(min(time_event, time_censor) * 100) / 100 + 0.01;
+  vec status = conv_to<vec>::from(time_event <= time_censor);
+
+  uvec order = sort_index(time);
+
+  d.x = d.x.rows(order);
+  d.y = join_horiz(time(order), status(order));
+  d.w.ones(n_rows);
+
+  return(d);
+
+ }
+
+ std::vector<uword> row_sizes(const BenchOptions& opts){
+
+  std::vector<uword> out;
+
+  for(uword n = 1000; n <= opts.max_rows; n *= 10){
+   out.push_back(n);
+  }
+
+  return(out);
+
+ }
+
+ const uword MAX_COLS = 32;
+ const std::vector<uword> COL_SIZES = {1, 8, 32};
+ const std::vector<uword> HORIZON_SIZES = {1, 10, 100, 1000};
+
+ // the c-statistic of continuous predictions is quadratic in rows
+ const uword CSTAT_MAX_ROWS = 100000;
+
+ // trees for the prediction kernels are grown on at most this many
+ // rows; prediction then runs on every row of the data
+ const uword TREE_MAX_ROWS = 100000;
+
+ void bench_split_stats(const BenchOptions& opts, SurvData& d, uword n){
+
+  mat& y = d.y;
+  vec& w = d.w;
+  vec p = d.x.col(0);
+
+  uvec g = conv_to<uvec>::from(p > 0);
+
+  TimeGroups groups;
+
+  if(selected(opts, "find_time_groups")){
+   run_kernel(opts, "find_time_groups", n, 1, 0, [&](){
+    find_time_groups(y, w, groups);
+    sink = sink + groups.rank.n_elem;
+   });
+  }
+
+  find_time_groups(y, w, groups);
+
+  if(selected(opts, "compute_logrank")){
+   run_kernel(opts, "compute_logrank", n, 1, 0, [&](){
+    sink = sink + compute_logrank(y, w, g, groups);
+   });
+  }
+
+  if(selected(opts, "compute_cstat_surv_split")){
+   run_kernel(opts, "compute_cstat_surv_split", n, 1, 0, [&](){
+    sink = sink + compute_cstat_surv(y, w, g, groups, true);
+   });
+  }
+
+  if(n <= CSTAT_MAX_ROWS && selected(opts, "compute_cstat_surv_pred")){
+   run_kernel(opts, "compute_cstat_surv_pred", n, 1, 0, [&](){
+    sink = sink + compute_cstat_surv(y, w, p, true);
+   });
+  }
+
+ }
+
+ void bench_fits(const BenchOptions& opts, SurvData& d, uword n){
+
+  mat& y = d.y;
+  vec& w = d.w;
+
+  TimeGroups groups;
+  find_time_groups(y, w, groups);
+
+  uword n_iter = 0;
+
+  FitOptions fit_options = {true, 1, 1e-9, 20, false, &n_iter};
+
+  WlsWorkspace ws;
+
+  for(uword n_cols : COL_SIZES){
+
+   mat x = d.x.submat(0, 0, n-1, n_cols-1);
+
+   // outcomes for regression and classification
+   mat y_linreg = x * d.beta.head(n_cols) + randn<vec>(n);
+   mat y_logreg = y.col(1);
+
+   if(selected(opts, "coxph_fit")){
+    run_kernel(opts, "coxph_fit", n, n_cols, 0, [&](){
+     mat beta = coxph_fit(x, y, w, groups, fit_options);
+     sink = sink + beta[0];
+    });
+   }
+
+   if(selected(opts, "linreg_fit")){
+    run_kernel(opts, "linreg_fit", n, n_cols, 0, [&](){
+     mat beta = linreg_fit(x, y_linreg, w, fit_options, ws);
+     sink = sink + beta[0];
+    });
+   }
+
+   if(selected(opts, "logreg_fit")){
+    run_kernel(opts, "logreg_fit", n, n_cols, 0, [&](){
+     mat beta = logreg_fit(x, y_logreg, w, fit_options, ws);
+     sink = sink + beta[0];
+    });
+   }
+
+  }
+
+ }
+
+ void bench_node(const BenchOptions& opts, SurvData& d, uword n){
+
+  if(selected(opts, "x_submat_mult_beta")){
+
+   Data data(d.x, d.y, d.w);
+
+   // a node holds a subset of rows, here every other one
+   uvec rows = regspace<uvec>(0, 2, n - 1);
+
+   for(uword n_cols : COL_SIZES){
+
+    uvec cols = regspace<uvec>(0, n_cols - 1);
+    vec beta = d.beta.head(n_cols);
+
+    run_kernel(opts, "x_submat_mult_beta", rows.n_elem, n_cols, 0, [&](){
+     vec lincomb = data.x_submat_mult_beta(rows, cols, beta);
+     sink = sink + lincomb[0];
+    });
+
+   }
+
+  }
+
+  mat& y = d.y;
+  vec& w = d.w;
+  vec lincomb = d.x * d.beta;
+  uvec lincomb_sort = sort_index(lincomb);
+
+  TreeSurvival tree;
+
+  tree.set_verbosity(0);
+  tree.set_y_node(y);
+  tree.set_w_node(w);
+  find_time_groups(y, w, tree.node_groups);
+  tree.set_lincomb(lincomb);
+  tree.set_lincomb_sort(lincomb_sort);
+  tree.set_leaf_min_obs(DEFAULT_LEAF_MIN_OBS);
+  tree.set_leaf_min_events(DEFAULT_LEAF_MIN_EVENTS);
+  tree.set_seed(329);
+  tree.set_split_max_cuts(DEFAULT_SPLIT_MAX_CUTS);
+  tree.set_split_rule(SPLIT_LOGRANK);
+
+  vec unique_event_times = find_unique_event_times(y);
+  tree.unique_event_times = &unique_event_times;
+
+  if(selected(opts, "find_all_cuts")){
+   run_kernel(opts, "find_all_cuts", n, 1, 0, [&](){
+    tree.find_all_cuts();
+    tree.sample_cuts();
+    sink = sink + tree.get_cuts_sampled().size();
+   });
+  }
+
+  tree.find_all_cuts();
+  tree.sample_cuts();
+
+  if(selected(opts, "find_best_cut")){
+   run_kernel(opts, "find_best_cut", n, 1, 0, [&](){
+    sink = sink + tree.find_best_cut();
+   });
+  }
+
+  if(selected(opts, "sprout_leaf")){
+   run_kernel(opts, "sprout_leaf", n, 1, 0, [&](){
+    // an empty offset makes resize_leaves() start a new set of
+    // leaves while the leaf buffers keep their capacity.
+    tree.get_leaf_pred_offset().reset();
+    tree.resize_leaves(1);
+    tree.sprout_leaf(0);
+    sink = sink + tree.get_leaf_summary()[0];
+   });
+  }
+
+ }
+
+ void bench_predict(const BenchOptions& opts, SurvData& d, uword n){
+
+  if(!selected(opts, "predict_leaf") &&
+     !selected(opts, "group_rows_by_leaf") &&
+     !selected(opts, "predict_value_internal")) return;
+
+  uword n_grow = std::min(n, TREE_MAX_ROWS);
+
+  mat x_grow = d.x.rows(0, n_grow - 1);
+  mat y_grow = d.y.rows(0, n_grow - 1);
+  vec w_grow = d.w.head(n_grow);
+
+  vec unique_event_times = find_unique_event_times(y_grow);
+
+  Data data_grow(x_grow, y_grow, w_grow);
+  data_grow.set_y_rank(find_time_ranks(y_grow.col(0), unique_event_times));
+
+  Data data_pred(d.x, d.y, d.w);
+
+  vec pred_horizon(1);
+  pred_horizon.fill(median(y_grow.col(0)));
+
+  TreeSurvival tree(DEFAULT_LEAF_MIN_EVENTS,
+                    DEFAULT_SPLIT_MIN_EVENTS,
+                    &unique_event_times,
+                    &pred_horizon);
+
+  tree.init(&data_grow, 329, 8, true, 0.632, PRED_RISK,
+            DEFAULT_LEAF_MIN_OBS, VI_NONE, 0.01, SPLIT_LOGRANK,
+            DEFAULT_SPLIT_MIN_OBS, DEFAULT_SPLIT_MIN_STAT,
+            DEFAULT_SPLIT_MAX_CUTS, DEFAULT_SPLIT_MAX_RETRY,
+            LC_GLM, 1e-9, 20, true, 0.5, 0, 1,
+            LincombFunction(), EvalFunction(), EVAL_NONE, 0);
+
+  vec oobag_denom(n_grow, fill::zeros);
+  vec vi_numer(x_grow.n_cols, fill::zeros);
+  uvec vi_denom(x_grow.n_cols, fill::zeros);
+
+  WlsWorkspace ws;
+
+  tree.grow(&oobag_denom, &vi_numer, &vi_denom, &ws, nullptr);
+
+  uvec leaves;
+
+  if(selected(opts, "predict_leaf")){
+   run_kernel(opts, "predict_leaf", n, d.x.n_cols, 0, [&](){
+    tree.predict_leaf(&data_pred, false, leaves);
+    sink = sink + leaves[0];
+   });
+  }
+
+  tree.predict_leaf(&data_pred, false, leaves);
+
+  LeafGroups groups;
+
+  if(selected(opts, "group_rows_by_leaf")){
+   run_kernel(opts, "group_rows_by_leaf", n, 1, 0, [&](){
+    tree.group_rows_by_leaf(leaves, groups);
+    sink = sink + groups.leaf_ids.n_elem;
+   });
+  }
+
+  tree.group_rows_by_leaf(leaves, groups);
+
+  if(!selected(opts, "predict_value_internal")) return;
+
+  for(uword n_horizon : HORIZON_SIZES){
+
+   // the tree reads horizons through its pointer to pred_horizon
+   pred_horizon = linspace<vec>(min(y_grow.col(0)),
+                                max(y_grow.col(0)),
+                                n_horizon);
+
+   mat pred(n, n_horizon);
+
+   run_kernel(opts, "predict_value_internal", n, 1, n_horizon, [&](){
+    pred.zeros();
+    tree.predict_value_internal(groups.leaf_ids, groups.leaf_bounds,
+                                groups.rows_grouped, pred,
+                                PRED_SURVIVAL, false);
+    sink = sink + pred[0];
+   });
+
+  }
+
+ }
+
+ void print_usage(){
+  std::cerr << "usage: aorsf_bench [--max-rows N] [--min-time S] " <<
+   "[--format=csv|json] [--filter TEXT]" << std::endl;
+ }
+
+ } // namespace
+
+ int main(int argc, char** argv){
+
+  BenchOptions opts;
+
+  for(int i = 1; i < argc; ++i){
+
+   std::string arg = argv[i];
+   std::string value;
+
+   // options are given as --name=value or --name value
+   std::string::size_type eq = arg.find('=');
+
+   if(eq != std::string::npos){
+    value = arg.substr(eq + 1);
+    arg = arg.substr(0, eq);
+   } else if(i + 1 < argc){
+    value = argv[++i];
+   } else {
+    print_usage();
+    return(1);
+   }
+
+   if(arg == "--max-rows"){
+    opts.max_rows = (uword) std::atof(value.c_str());
+   } else if(arg == "--min-time"){
+    opts.min_time = std::atof(value.c_str());
+   } else if(arg == "--format"){
+    // anything else would quietly switch scripts reading json to csv
+    if(value != "csv" && value != "json"){
+     std::cerr << "aorsf_bench: unknown --format '" << value <<
+      "'; use csv or json" << std::endl;
+     return(1);
+    }
+    opts.json = (value == "json");
+   } else if(arg == "--filter"){
+    opts.filter = value;
+   } else {
+    print_usage();
+    return(1);
+   }
+
+  }
+
+  arma_rng::set_seed(329);
+
+  write_header(opts);
+
+  try {
+
+   for(uword n : row_sizes(opts)){
+
+    SurvData d = make_surv_data(n, MAX_COLS);
+
+    bench_split_stats(opts, d, n);
+    bench_fits(opts, d, n);
+    bench_node(opts, d, n);
+    bench_predict(opts, d, n);
+   }
+
+  } catch (const std::exception& e) {
+   std::cerr << "aorsf_bench: " << e.what() << std::endl;
+   return(1);
+  }
+
+  return(0);
+
+ }
@@ -102,6 +102,21 @@
 
  const PredType DEFAULT_PRED_TYPE = PRED_RISK;
 
+ // multi-threaded prediction splits rows across threads (in blocks of
+ // this many rows) instead of splitting trees when per-thread copies
+ // of the result would hold more than this many values in total
+ const arma::uword DEFAULT_PRED_BLOCK_ROWS = 1024;
+ const arma::uword DEFAULT_PRED_THREAD_VALUES = 16777216;
+
+ // summary partial dependence holds at most this many predictions
+ // per thread, and each quantile sketch is exact up to this many values
+ const arma::uword DEFAULT_PD_BLOCK_VALUES = 4194304;
+ const arma::uword DEFAULT_PD_SKETCH_SIZE = 4096;
+
+ // events kept per thread by a trace recorder; older events are
+ // overwritten once a thread records more than this many
+ const arma::uword DEFAULT_TRACE_EVENTS = 65536;
+
  // Interval to print progress in seconds
  const double STATUS_INTERVAL = 1.0;
 
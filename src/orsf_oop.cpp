@@ -11,6 +11,7 @@
 #include <RcppArmadillo.h>
 #include <vector>
 #include <memory>
+#include <fstream>
 #include <utility>
 
 #include "globals.h"
@@ -19,6 +20,7 @@
 #include "ForestSurvival.h"
 #include "ForestClassification.h"
 #include "ForestRegression.h"
+#include "ForestFile.h"
 #include "Coxph.h"
 #include "utility.h"
 
@@ -162,6 +164,7 @@
 
   tree.set_y_node(y);
   tree.set_w_node(w);
+  find_time_groups(y, w, tree.node_groups);
   tree.set_lincomb(lincomb);
   tree.set_lincomb_sort(lincomb_sort);
   tree.set_leaf_min_obs(leaf_min_obs);
@@ -187,26 +190,34 @@
 
  // [[Rcpp::export]]
  List sprout_node_survival_exported(arma::mat& y,
-                                    arma::vec& w){
+                                    arma::vec& w,
+                                    arma::uword node_id){
 
   TreeSurvival tree;
 
-  arma::uword node_id = 0;
-  arma::uword leaf_size = 1;
+  arma::uword leaf_size = node_id + 1;
 
   tree.unique_event_times = new vec(find_unique_event_times(y));
   tree.set_y_node(y);
   tree.set_w_node(w);
+  find_time_groups(y, w, tree.node_groups);
 
   tree.resize_leaves(leaf_size);
+
+  // a leaf sprouted before node_id puts values ahead of node_id's,
+  // and the nodes in between stay unsprouted
+  if(node_id > 0) tree.sprout_leaf(0);
+
   tree.sprout_leaf(node_id);
 
   List result;
 
-  result.push_back(tree.get_leaf_pred_indx(), "indx");
-  result.push_back(tree.get_leaf_pred_prob(), "prob");
-  result.push_back(tree.get_leaf_pred_chaz(), "chaz");
-  result.push_back(tree.get_leaf_summary(),   "mort");
+  mat leaf_data = tree.get_leaf_data(node_id);
+
+  result.push_back(vec(leaf_data.col(0)), "time");
+  result.push_back(vec(leaf_data.col(1)), "surv");
+  result.push_back(vec(leaf_data.col(2)), "chaz");
+  result.push_back(tree.get_leaf_summary()[node_id], "mort");
 
   delete tree.unique_event_times;
 
@@ -227,6 +238,29 @@
 
  }
 
+ // [[Rcpp::export]]
+ List group_rows_by_leaf_exported(arma::uvec& leaves,
+                                  arma::uword n_nodes){
+
+  // grouping only depends on the number of nodes in the tree
+  TreeRegression tree;
+
+  tree.get_child_left().resize(n_nodes);
+
+  LeafGroups groups;
+
+  tree.group_rows_by_leaf(leaves, groups);
+
+  List result;
+
+  result.push_back(groups.leaf_ids, "leaf_ids");
+  result.push_back(groups.leaf_bounds, "leaf_bounds");
+  result.push_back(groups.rows_grouped, "rows_grouped");
+
+  return(result);
+
+ }
+
  // [[Rcpp::export]]
  arma::vec x_submat_mult_beta_exported(arma::mat& x,
                                        arma::mat& y,
@@ -340,6 +374,180 @@ double compute_mse_exported(arma::vec& y,
 }
 
 
+ // telemetry values in the order of telemetry_names
+ static arma::rowvec telemetry_values(const TreeTelemetry& x){
+
+  arma::rowvec out = {
+   x.time_sample_rows,
+   x.time_node_prep,
+   x.time_lincomb,
+   x.time_sort_index,
+   x.time_find_all_cuts,
+   x.time_find_best_cut,
+   x.time_sprout_leaf,
+   x.time_routing,
+   (double) x.n_lincomb_fits,
+   (double) x.n_lincomb_iter,
+   (double) x.n_split_retry,
+   (double) x.n_nodes,
+   (double) x.n_leaves,
+   (double) x.max_depth,
+   (double) x.n_rows_touched
+  };
+
+  return(out);
+
+ }
+
+ static CharacterVector telemetry_names(){
+
+  return(CharacterVector::create(
+    "time_sample_rows", "time_node_prep", "time_lincomb",
+    "time_sort_index", "time_find_all_cuts", "time_find_best_cut",
+    "time_sprout_leaf", "time_routing", "n_lincomb_fits", "n_lincomb_iter",
+    "n_split_retry", "n_nodes", "n_leaves", "max_depth",
+    "n_rows_touched"
+  ));
+
+ }
+
+ // trees: one row of counters and timers per tree
+ // total: sums over trees (max_depth is the max over trees)
+ // phases: wall time of each phase of Forest::run()
+ // memory: bytes held by the trees of the forest, the peak
+ //   accounted memory (see MemoryTracker) of each phase, and the
+ //   number of threads that grew trees with the bytes each reserved
+ static List telemetry_to_list(Forest& forest){
+
+  std::vector<TreeTelemetry> tree_telemetry = forest.get_tree_telemetry();
+
+  CharacterVector names = telemetry_names();
+
+  arma::mat trees(tree_telemetry.size(), names.size());
+
+  TreeTelemetry total;
+
+  for(uword i = 0; i < tree_telemetry.size(); ++i){
+   trees.row(i) = telemetry_values(tree_telemetry[i]);
+   total.add(tree_telemetry[i]);
+  }
+
+  NumericMatrix trees_R = wrap(trees);
+  colnames(trees_R) = names;
+
+  arma::rowvec total_values = telemetry_values(total);
+
+  NumericVector total_R(total_values.begin(), total_values.end());
+  total_R.names() = names;
+
+  ForestTelemetry& phases = forest.get_telemetry();
+
+  NumericVector phases_R = NumericVector::create(
+   Named("grow") = phases.time_grow,
+   Named("predict") = phases.time_predict,
+   Named("importance") = phases.time_importance,
+   Named("dependence") = phases.time_dependence
+  );
+
+  ModelBytes model = forest.compute_model_bytes();
+
+  NumericVector model_R = NumericVector::create(
+   Named("nodes") = model.nodes,
+   Named("coefficients") = model.coefficients,
+   Named("leaves") = model.leaves,
+   Named("oobag_rows") = model.oobag_rows
+  );
+
+  NumericVector peak_R = NumericVector::create(
+   Named("grow") = phases.peak_grow,
+   Named("predict") = phases.peak_predict,
+   Named("importance") = phases.peak_importance,
+   Named("dependence") = phases.peak_dependence
+  );
+
+  List result;
+  result.push_back(trees_R, "trees");
+  result.push_back(total_R, "total");
+  result.push_back(phases_R, "phases");
+  NumericVector grow_R = NumericVector::create(
+   Named("n_thread") = phases.n_thread_grow,
+   Named("bytes_per_thread") = phases.bytes_grow_thread
+  );
+
+  result.push_back(List::create(Named("model") = model_R,
+                                Named("peak") = peak_R,
+                                Named("grow") = grow_R),
+                   "memory");
+
+  return(result);
+
+ }
+
+ // R functions that the engine calls through Runtime.h. Both are
+ // only used when n_thread is 1, because R is single threaded.
+ static LincombFunction lincomb_function_from_R(RObject f,
+                                                LinearCombo lincomb_type,
+                                                double lincomb_alpha,
+                                                uword lincomb_df_target){
+
+  bool uses_function = (lincomb_type == LC_GLMNET ||
+                        lincomb_type == LC_R_FUNCTION);
+
+  if(!uses_function || !Rf_isFunction(f)) return(LincombFunction());
+
+  Function f_beta = as<Function>(f);
+
+  return([f_beta, lincomb_type, lincomb_alpha, lincomb_df_target]
+         (const mat& x, const mat& y, const vec& w){
+
+   NumericMatrix xx = wrap(x);
+   NumericMatrix yy = wrap(y);
+   NumericVector ww = wrap(w);
+
+   NumericMatrix beta_R = (lincomb_type == LC_GLMNET) ?
+    f_beta(xx, yy, ww, lincomb_alpha, lincomb_df_target) :
+    f_beta(xx, yy, ww);
+
+   return(mat(beta_R.begin(), beta_R.nrow(), beta_R.ncol()));
+
+  });
+
+ }
+
+ static EvalFunction eval_function_from_R(RObject f){
+
+  if(!Rf_isFunction(f)) return(EvalFunction());
+
+  Function f_oobag_eval = as<Function>(f);
+
+  return([f_oobag_eval](const mat& y, const vec& w, const vec& p){
+
+   NumericMatrix y_ = wrap(y);
+   NumericVector w_ = wrap(w);
+   NumericVector p_ = wrap(p);
+
+   NumericVector R_result = f_oobag_eval(y_, w_, p_);
+
+   return(R_result[0]);
+
+  });
+
+ }
+
+ // an element of a loaded forest, or an empty matrix if it is missing
+ // or empty (e.g., vi_numer of a forest without variable importance)
+ static arma::mat cached_mat(Rcpp::List& loaded_forest, const char* name){
+
+  if(!loaded_forest.containsElementNamed(name)) return(arma::mat());
+
+  RObject value = loaded_forest[name];
+
+  if(Rf_length(value) == 0) return(arma::mat());
+
+  return(as<arma::mat>(value));
+
+ }
+
  /*
   * @description Bridge between Cpp routines and R code. Receives
   *   R objects, initializes the requested Forest object, and does
@@ -403,7 +611,15 @@ double compute_mse_exported(arma::vec& y,
                unsigned int             n_thread,
                bool                     write_forest,
                bool                     run_forest,
-               int                      verbosity){
+               int                      verbosity,
+               std::string              trace_file,
+               double                   max_memory,
+               bool                     append_forest,
+               double                   oobag_stop_tolerance,
+               arma::uword              oobag_stop_window,
+               double                   max_seconds,
+               std::string              checkpoint_file,
+               arma::uword              checkpoint_every){
 
   // re-cast integer inputs from R into enumerations
   VariableImportance vi_type = (VariableImportance) vi_type_R;
@@ -430,20 +646,35 @@ double compute_mse_exported(arma::vec& y,
   // does the forest need to be grown?
   bool grow_mode = loaded_forest.size() == 0;
 
+  // early stopping compares out-of-bag evaluations
+  if((grow_mode || append_forest) && oobag_stop_tolerance > 0 &&
+     oobag_eval_type == EVAL_NONE){
+   Rcpp::stop("oobag_stop_tolerance > 0 requires an out-of-bag evaluation "
+              "type, but oobag_eval_type is 'none'. Set oobag_stop_tolerance "
+              "to 0 or use an out-of-bag evaluation.");
+  }
+
   // R functions cannot be called from multiple threads
   if(lincomb_type    == LC_R_FUNCTION  ||
      lincomb_type    == LC_GLMNET      ){
-   if(grow_mode) n_thread = 1;
+   if(grow_mode || append_forest) n_thread = 1;
   }
 
   if(oobag_eval_type == EVAL_R_FUNCTION){
    n_thread = 1;
   }
 
+  // trees grown in steps are evaluated after each step
+  // (see Forest::grow_in_steps)
+  bool grow_stepwise = oobag_stop_tolerance > 0 ||
+   (!checkpoint_file.empty() && checkpoint_every > 0);
+
   // might need to set n_thread to 1 if oobag pred is monitored
-  if(oobag_eval_every < n_tree){
+  // (not when growing in steps)
+  if(oobag_eval_every < n_tree && !grow_stepwise){
    // specifically if this isn't true we need to go single thread
-   if(n_tree/oobag_eval_every != n_thread){
+   // (and always when trees are added to a forest, see Forest::predict)
+   if(n_tree/oobag_eval_every != n_thread || append_forest){
     n_thread = 1;
    }
   }
@@ -503,7 +734,7 @@ double compute_mse_exported(arma::vec& y,
 
 
   forest->init(std::move(data),
-               tree_seeds,
+               as<std::vector<int>>(tree_seeds),
                n_tree,
                mtry,
                sample_with_replacement,
@@ -524,7 +755,10 @@ double compute_mse_exported(arma::vec& y,
                lincomb_alpha,
                lincomb_df_target,
                lincomb_ties_method,
-               lincomb_R_function,
+               lincomb_function_from_R(lincomb_R_function,
+                                       lincomb_type,
+                                       lincomb_alpha,
+                                       lincomb_df_target),
                pred_type,
                pred_mode,
                pred_aggregate,
@@ -535,15 +769,40 @@ double compute_mse_exported(arma::vec& y,
                oobag,
                oobag_eval_type,
                oobag_eval_every,
-               oobag_R_function,
+               eval_function_from_R(oobag_R_function),
                n_thread,
                verbosity);
 
+   if(!trace_file.empty()) forest->init_trace();
+
+   forest->set_max_memory(max_memory);
+
+   if(grow_mode || append_forest){
+    forest->set_oobag_stop(oobag_stop_tolerance, oobag_stop_window);
+    forest->set_grow_budget(max_seconds);
+   }
+
+   if(grow_mode && !checkpoint_file.empty()){
+
+    forest->set_checkpoint(checkpoint_file, checkpoint_every);
+
+    // pick up where an earlier, unfinished run left off
+    if(std::ifstream(checkpoint_file).good()){
+     forest->resume_checkpoint();
+    }
+
+   }
+
    // Load forest object if it was already grown
    if(!grow_mode){
 
     n_obs = loaded_forest["n_obs"];
 
+    // when appending, n_tree is the total after appending, and the
+    // number of trees to load is read from the forest
+    uword n_tree_load = append_forest ?
+     as<List>(loaded_forest["cutpoint"]).size() : n_tree;
+
     std::vector<uvec>                rows_oobag   = loaded_forest["rows_oobag"];
     std::vector<std::vector<double>> cutpoint     = loaded_forest["cutpoint"];
     std::vector<std::vector<uword>>  child_left   = loaded_forest["child_left"];
@@ -554,16 +813,19 @@ double compute_mse_exported(arma::vec& y,
 
     if(tree_type == TREE_SURVIVAL){
 
-     std::vector<std::vector<vec>> leaf_pred_indx = loaded_forest["leaf_pred_indx"];
-     std::vector<std::vector<vec>> leaf_pred_prob = loaded_forest["leaf_pred_prob"];
-     std::vector<std::vector<vec>> leaf_pred_chaz = loaded_forest["leaf_pred_chaz"];
+     std::vector<uvec>     leaf_pred_offset   = loaded_forest["leaf_pred_offset"];
+     std::vector<Col<u32>> leaf_pred_indx     = loaded_forest["leaf_pred_indx"];
+     std::vector<vec>      leaf_pred_prob     = loaded_forest["leaf_pred_prob"];
+     std::vector<vec>      leaf_pred_chaz     = loaded_forest["leaf_pred_chaz"];
+     vec                   unique_event_times = loaded_forest["unique_event_times"];
 
      auto& temp = dynamic_cast<ForestSurvival&>(*forest);
 
-     temp.load(n_tree, n_obs, rows_oobag, cutpoint, child_left,
-               coef_values, coef_indices, leaf_pred_indx,
-               leaf_pred_prob, leaf_pred_chaz, leaf_summary,
-               oobag_denom, pd_type, pd_x_vals, pd_x_cols, pd_probs);
+     temp.load(n_tree_load, n_obs, rows_oobag, cutpoint, child_left,
+               coef_values, coef_indices, leaf_pred_offset,
+               leaf_pred_indx, leaf_pred_prob, leaf_pred_chaz,
+               leaf_summary, unique_event_times, oobag_denom,
+               pd_type, pd_x_vals, pd_x_cols, pd_probs);
 
     } else if (tree_type == TREE_CLASSIFICATION){
 
@@ -573,7 +835,7 @@ double compute_mse_exported(arma::vec& y,
 
      uword n_class = y.n_cols;
 
-     temp.load(n_tree, n_obs, n_class, rows_oobag, cutpoint, child_left,
+     temp.load(n_tree_load, n_obs, n_class, rows_oobag, cutpoint, child_left,
                coef_values, coef_indices, leaf_pred_prob, leaf_summary,
                oobag_denom, pd_type, pd_x_vals, pd_x_cols, pd_probs);
 
@@ -584,22 +846,39 @@ double compute_mse_exported(arma::vec& y,
 
      auto& temp = dynamic_cast<ForestRegression&>(*forest);
 
-     temp.load(n_tree, n_obs, rows_oobag, cutpoint, child_left,
+     temp.load(n_tree_load, n_obs, rows_oobag, cutpoint, child_left,
                coef_values, coef_indices, leaf_pred_prob, leaf_summary,
                oobag_denom, pd_type, pd_x_vals, pd_x_cols, pd_probs);
 
 
     }
 
+    if(append_forest){
+
+     // sums from the loaded trees, written with the forest below
+     mat  oobag_pred_sum = cached_mat(loaded_forest, "oobag_pred_sum");
+     mat  oobag_eval     = cached_mat(loaded_forest, "oobag_eval");
+     vec  vi_numer       = vectorise(cached_mat(loaded_forest, "vi_numer"));
+     uvec vi_denom       = conv_to<uvec>::from(
+      vectorise(cached_mat(loaded_forest, "vi_denom"))
+     );
+
+     forest->init_append(n_tree, oobag_pred_sum, oobag_eval,
+                         vi_numer, vi_denom);
+
+    }
+
    }
 
    if(run_forest){ forest->run(oobag); }
 
+   if(!trace_file.empty()) forest->write_trace(trace_file);
+
    if(pred_mode){
 
     result.push_back(forest->get_predictions(), "pred_new");
 
-   } else if (grow_mode) {
+   } else if (grow_mode || append_forest) {
 
     if (oobag) result.push_back(forest->get_predictions(), "pred_oobag");
 
@@ -608,6 +887,12 @@ double compute_mse_exported(arma::vec& y,
     eval_oobag.push_back(oobag_eval_type_R, "stat_type");
     result.push_back(eval_oobag, "eval_oobag");
 
+    result.push_back(telemetry_to_list(*forest), "telemetry");
+
+    // trees skipped when the time limit passed leave gaps in the seeds
+    result.push_back(forest->get_tree_seeds(), "tree_seeds");
+    result.push_back(forest->get_grow_cancelled(), "grow_cancelled");
+
    }
 
    if(write_forest){
@@ -622,9 +907,19 @@ double compute_mse_exported(arma::vec& y,
     forest_out.push_back(forest->get_coef_values(), "coef_values");
     forest_out.push_back(forest->get_leaf_summary(), "leaf_summary");
 
+    // running sums that let orsf_add_trees() grow more trees later
+    if(grow_mode || append_forest){
+     forest_out.push_back(forest->get_oobag_pred_sum(), "oobag_pred_sum");
+     forest_out.push_back(forest->get_oobag_eval(), "oobag_eval");
+     forest_out.push_back(forest->get_vi_numer(), "vi_numer");
+     forest_out.push_back(forest->get_vi_denom(), "vi_denom");
+    }
+
     if(tree_type == TREE_SURVIVAL){
 
      auto& temp = dynamic_cast<ForestSurvival&>(*forest);
+     forest_out.push_back(temp.get_unique_event_times(), "unique_event_times");
+     forest_out.push_back(temp.get_leaf_pred_offset(), "leaf_pred_offset");
      forest_out.push_back(temp.get_leaf_pred_indx(), "leaf_pred_indx");
      forest_out.push_back(temp.get_leaf_pred_prob(), "leaf_pred_prob");
      forest_out.push_back(temp.get_leaf_pred_chaz(), "leaf_pred_chaz");
@@ -658,7 +953,8 @@ double compute_mse_exported(arma::vec& y,
       vi_output = forest->get_vi_numer() / denom;
 
      } else {
-      vi_output = forest->get_vi_numer() / n_tree;
+      // n_tree may be fewer than requested if growth stopped early
+      vi_output = forest->get_vi_numer() / forest->get_n_tree();
      }
     }
     result.push_back(vi_output, "importance");
@@ -673,3 +969,266 @@ double compute_mse_exported(arma::vec& y,
 
  }
 
+
+ // a forest loaded from its R representation, ready for scoring
+ std::unique_ptr<Forest> load_scorer_forest(Rcpp::List& loaded_forest,
+                                            TreeType tree_type,
+                                            arma::uword n_class,
+                                            PredType pred_type,
+                                            arma::vec& pred_horizon){
+
+  std::unique_ptr<Forest> forest { };
+
+  uword n_obs = loaded_forest["n_obs"];
+
+  std::vector<uvec>                rows_oobag   = loaded_forest["rows_oobag"];
+  std::vector<std::vector<double>> cutpoint     = loaded_forest["cutpoint"];
+  std::vector<std::vector<uword>>  child_left   = loaded_forest["child_left"];
+  std::vector<std::vector<vec>>    coef_values  = loaded_forest["coef_values"];
+  std::vector<std::vector<uvec>>   coef_indices = loaded_forest["coef_indices"];
+  std::vector<std::vector<double>> leaf_summary = loaded_forest["leaf_summary"];
+  vec                              oobag_denom  = loaded_forest["oobag_denom"];
+
+  uword n_tree = cutpoint.size();
+
+  // the scorer does not compute partial dependence
+  std::vector<arma::mat>  pd_x_vals;
+  std::vector<arma::uvec> pd_x_cols;
+  arma::vec               pd_probs;
+
+  switch(tree_type){
+
+  case TREE_SURVIVAL: {
+
+   std::vector<uvec>     leaf_pred_offset   = loaded_forest["leaf_pred_offset"];
+   std::vector<Col<u32>> leaf_pred_indx     = loaded_forest["leaf_pred_indx"];
+   std::vector<vec>      leaf_pred_prob     = loaded_forest["leaf_pred_prob"];
+   std::vector<vec>      leaf_pred_chaz     = loaded_forest["leaf_pred_chaz"];
+   vec                   unique_event_times = loaded_forest["unique_event_times"];
+
+   auto temp = std::make_unique<ForestSurvival>(0, 0, pred_horizon);
+
+   temp->init_scorer(pred_type);
+
+   temp->load(n_tree, n_obs, rows_oobag, cutpoint, child_left,
+              coef_values, coef_indices, leaf_pred_offset,
+              leaf_pred_indx, leaf_pred_prob, leaf_pred_chaz,
+              leaf_summary, unique_event_times, oobag_denom,
+              PD_NONE, pd_x_vals, pd_x_cols, pd_probs);
+
+   forest = std::move(temp);
+
+   break;
+
+  }
+
+  case TREE_CLASSIFICATION: {
+
+   std::vector<std::vector<vec>> leaf_pred_prob = loaded_forest["leaf_pred_prob"];
+
+   auto temp = std::make_unique<ForestClassification>(n_class);
+
+   temp->init_scorer(pred_type);
+
+   temp->load(n_tree, n_obs, n_class, rows_oobag, cutpoint, child_left,
+              coef_values, coef_indices, leaf_pred_prob, leaf_summary,
+              oobag_denom, PD_NONE, pd_x_vals, pd_x_cols, pd_probs);
+
+   forest = std::move(temp);
+
+   break;
+
+  }
+
+  case TREE_REGRESSION: {
+
+   std::vector<std::vector<vec>> leaf_pred_prob = loaded_forest["leaf_pred_prob"];
+
+   auto temp = std::make_unique<ForestRegression>();
+
+   temp->init_scorer(pred_type);
+
+   temp->load(n_tree, n_obs, rows_oobag, cutpoint, child_left,
+              coef_values, coef_indices, leaf_pred_prob, leaf_summary,
+              oobag_denom, PD_NONE, pd_x_vals, pd_x_cols, pd_probs);
+
+   forest = std::move(temp);
+
+   break;
+
+  }
+
+  default:
+
+   Rcpp::stop("unrecognized tree type");
+   break;
+
+  }
+
+  return(forest);
+
+ }
+
+ // [[Rcpp::export]]
+ SEXP orsf_scorer_cpp(Rcpp::List& loaded_forest,
+                      arma::uword tree_type_R,
+                      arma::uword n_class,
+                      arma::uword pred_type_R,
+                      arma::vec   pred_horizon){
+
+  std::unique_ptr<Forest> forest = load_scorer_forest(loaded_forest,
+                                                      (TreeType) tree_type_R,
+                                                      n_class,
+                                                      (PredType) pred_type_R,
+                                                      pred_horizon);
+
+  // the forest stays in memory until R garbage collects the pointer
+  Rcpp::XPtr<Forest> result(forest.release(), true);
+
+  return(result);
+
+ }
+
+ // [[Rcpp::export]]
+ void orsf_write_binary_cpp(Rcpp::List& loaded_forest,
+                            arma::uword tree_type_R,
+                            arma::uword n_class,
+                            std::string file_path,
+                            Rcpp::RawVector metadata){
+
+  // leaf values for every pred_type are written, so neither the
+  // pred_type nor the prediction horizon matter here.
+  arma::vec pred_horizon(1, fill::ones);
+
+  std::unique_ptr<Forest> forest = load_scorer_forest(loaded_forest,
+                                                      (TreeType) tree_type_R,
+                                                      n_class,
+                                                      PRED_NONE,
+                                                      pred_horizon);
+
+  std::vector<unsigned char> metadata_bytes(metadata.begin(),
+                                            metadata.end());
+
+  forest->write_binary(file_path, metadata_bytes);
+
+ }
+
+ // [[Rcpp::export]]
+ Rcpp::RawVector orsf_read_binary_metadata_cpp(std::string file_path){
+
+  ForestFileReader reader(std::make_shared<MappedFile>(file_path));
+
+  reader.read_header();
+
+  std::vector<unsigned char> metadata = reader.read_blob();
+
+  return(Rcpp::RawVector(metadata.begin(), metadata.end()));
+
+ }
+
+ // [[Rcpp::export]]
+ SEXP orsf_scorer_binary_cpp(std::string file_path,
+                             arma::uword pred_type_R,
+                             arma::vec   pred_horizon){
+
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(file_path);
+
+  ForestFileHeader header = ForestFileReader(file).read_header();
+
+  std::unique_ptr<Forest> forest { };
+
+  switch(header.tree_type){
+
+  case TREE_SURVIVAL:
+   forest = std::make_unique<ForestSurvival>(0, 0, pred_horizon);
+   break;
+
+  case TREE_CLASSIFICATION:
+   forest = std::make_unique<ForestClassification>(header.n_class);
+   break;
+
+  case TREE_REGRESSION:
+   forest = std::make_unique<ForestRegression>();
+   break;
+
+  default:
+   Rcpp::stop("unrecognized tree type");
+   break;
+
+  }
+
+  forest->init_scorer((PredType) pred_type_R);
+
+  // trees read leaf values and coefficients directly from the file's
+  // memory, which is released when the forest is.
+  forest->load_binary(file);
+
+  Rcpp::XPtr<Forest> result(forest.release(), true);
+
+  return(result);
+
+ }
+
+
+ // [[Rcpp::export]]
+ arma::mat orsf_scorer_predict_cpp(SEXP scorer,
+                                   arma::mat& x){
+
+  Rcpp::XPtr<Forest> forest(scorer);
+
+  // pointers are not saved with R objects, e.g., by saveRDS()
+  if(forest.get() == NULL){
+   Rcpp::stop("scorer is no longer in memory; please re-create it.");
+  }
+
+  return(forest->predict_batch(x));
+
+ }
+
+ // [[Rcpp::export]]
+ List scorer_predict_concurrent_exported(SEXP scorer,
+                                         arma::mat& x,
+                                         arma::uword n_thread,
+                                         arma::uword n_repeat){
+
+  Rcpp::XPtr<Forest> scorer_ptr(scorer);
+
+  if(scorer_ptr.get() == NULL){
+   Rcpp::stop("scorer is no longer in memory; please re-create it.");
+  }
+
+  // worker threads only touch the forest, not R's external pointer
+  const Forest* forest = scorer_ptr.get();
+
+  // each thread scores x n_repeat times with the same forest,
+  // and all of them run at the same time
+  std::vector<std::vector<arma::mat>> preds(n_thread);
+  std::vector<std::thread> threads;
+
+  threads.reserve(n_thread);
+
+  for(uword i = 0; i < n_thread; ++i){
+
+   preds[i].resize(n_repeat);
+
+   threads.emplace_back([forest, &x, &preds, i, n_repeat](){
+    for(uword r = 0; r < n_repeat; ++r){
+     preds[i][r] = forest->predict_batch(x);
+    }
+   });
+
+  }
+
+  for(auto& thread : threads) thread.join();
+
+  List result;
+
+  for(auto& preds_thread : preds){
+   for(auto& pred : preds_thread){
+    result.push_back(pred);
+   }
+  }
+
+  return(result);
+
+ }
@@ -4,12 +4,13 @@
  aorsf may be modified and distributed under the terms of the MIT license.
 #----------------------------------------------------------------------------*/
 
-#include <RcppArmadillo.h>
+#include "Runtime.h"
 #include "utility.h"
 #include "globals.h"
 
+#include <limits>
+
  using namespace arma;
- using namespace Rcpp;
 
  namespace aorsf {
 
@@ -26,9 +27,9 @@
   if(x.n_cols < max_cols) ncol_print = x.n_cols-1;
 
 
-  Rcout << "   -- " << label << std::endl << std::endl;
-  Rcout << x.submat(0, 0, nrow_print, ncol_print);
-  Rcout << std::endl << std::endl;
+  console() << "   -- " << label << std::endl << std::endl;
+  console() << x.submat(0, 0, nrow_print, ncol_print);
+  console() << std::endl << std::endl;
 
  }
 
@@ -39,15 +40,15 @@
   uword n_print = max_elem-1;
 
   if(x.size() <= n_print) n_print = x.size()-1;
-  Rcout << "   -- " << label << std::endl << std::endl;
+  console() << "   -- " << label << std::endl << std::endl;
 
   if(x.size() == 0){
-   Rcout << "   empty vector";
+   console() << "   empty vector";
   } else {
-   Rcout << x.subvec(0, n_print).t();
+   console() << x.subvec(0, n_print).t();
   }
 
-  Rcout << std::endl << std::endl;
+  console() << std::endl << std::endl;
 
  }
 
@@ -58,15 +59,15 @@
   uword n_print = max_elem-1;
 
   if(x.size() <= n_print) n_print = x.size()-1;
-  Rcout << "   -- " << label << std::endl << std::endl;
+  console() << "   -- " << label << std::endl << std::endl;
 
   if(x.size() == 0){
-   Rcout << "   empty vector";
+   console() << "   empty vector";
   } else {
-   Rcout << x.subvec(0, n_print).t();
+   console() << x.subvec(0, n_print).t();
   }
 
-  Rcout << std::endl << std::endl;
+  console() << std::endl << std::endl;
 
  }
 
@@ -178,41 +179,113 @@
  }
 
 
+ arma::uvec find_time_ranks(const arma::vec& y_time,
+                            const arma::vec& event_times){
+
+  uvec result(y_time.n_elem);
+
+  for(uword i = 0; i < y_time.n_elem; ++i){
+
+   uword k = std::lower_bound(event_times.begin(),
+                              event_times.end(),
+                              y_time[i]) - event_times.begin();
+
+   bool is_event_time = k < event_times.n_elem && event_times[k] == y_time[i];
+
+   result[i] = 2 * k + is_event_time;
+
+  }
+
+  return(result);
+
+ }
+
+ void find_time_groups(arma::mat& y,
+                       arma::vec& w,
+                       const arma::uvec& y_rank,
+                       TimeGroups& groups){
+
+  vec y_status = y.unsafe_col(1);
+
+  uword n_rows = y.n_rows;
+
+  // at most one group per row; trimmed below
+  groups.start.set_size(n_rows + 1);
+  groups.rank.set_size(n_rows);
+  groups.weight.zeros(n_rows);
+  groups.events.zeros(n_rows);
+
+  uword n_groups = 0;
+
+  for(uword i = 0; i < n_rows; ++i){
+
+   if(i == 0 || y_rank[i] != y_rank[i-1]){
+    groups.start[n_groups] = i;
+    groups.rank[n_groups] = y_rank[i];
+    n_groups++;
+   }
+
+   groups.weight[n_groups-1] += w[i];
+   groups.events[n_groups-1] += y_status[i] * w[i];
+
+  }
+
+  groups.start[n_groups] = n_rows;
+
+  groups.start.resize(n_groups + 1);
+  groups.rank.resize(n_groups);
+  groups.weight.resize(n_groups);
+  groups.events.resize(n_groups);
+
+ }
+
+ void find_time_groups(arma::mat& y,
+                       arma::vec& w,
+                       TimeGroups& groups){
+
+  vec y_time = y.unsafe_col(0);
+
+  uvec y_rank = find_time_ranks(y_time, find_unique_event_times(y));
+
+  find_time_groups(y, w, y_rank, groups);
+
+ }
+
  double compute_logrank(arma::mat& y,
                         arma::vec& w,
                         arma::uvec& g){
 
-  double n_risk=0, g_risk=0, observed=0, expected=0, V=0,
-   temp1, temp2, n_events;
+  TimeGroups groups;
 
-  vec y_time = y.unsafe_col(0);
-  vec y_status = y.unsafe_col(1);
+  find_time_groups(y, w, groups);
 
-  bool break_loop = false;
+  return(compute_logrank(y, w, g, groups));
 
-  uword i = y.n_rows-1;
+ }
 
-  // breaking condition of outer loop governed by inner loop
-  for (; ;){
+ double compute_logrank(arma::mat& y,
+                        arma::vec& w,
+                        arma::uvec& g,
+                        const TimeGroups& groups){
 
-   temp1 = y_time(i);
+  double n_risk=0, g_risk=0, observed=0, expected=0, V=0,
+   temp1, temp2, n_events;
 
-   n_events = 0;
+  vec y_status = y.unsafe_col(1);
 
-   for ( ; y_time[i] == temp1; i--) {
+  // walk backwards through the tie groups. Group sums of w and
+  // w * status come from groups, so only the sums involving g
+  // are computed here.
+  for (uword k = groups.rank.n_elem; k-- > 0; ){
 
-    n_risk += w[i];
-    n_events += y_status[i] * w[i];
+   for (uword i = groups.start[k]; i < groups.start[k+1]; ++i) {
     g_risk += g[i] * w[i];
     observed += y_status[i] * g[i] * w[i];
-
-    if(i == 0){
-     break_loop = true;
-     break;
-    }
-
    }
 
+   n_risk += groups.weight[k];
+   n_events = groups.events[k];
+
    // should only do these calculations if n_events > 0,
    // but multiplying by 0 is usually faster than checking
    temp2 = g_risk / n_risk;
@@ -225,8 +298,6 @@
     V += temp1 * (1 - temp2);
    }
 
-   if(break_loop) break;
-
   }
 
   return(pow(expected-observed, 2) / V);
@@ -288,56 +359,86 @@
                            arma::uvec& g,
                            bool pred_is_risklike){
 
+  TimeGroups groups;
+
+  find_time_groups(y, w, groups);
+
+  return(compute_cstat_surv(y, w, g, groups, pred_is_risklike));
+
+ }
+
+ double compute_cstat_surv(arma::mat& y,
+                           arma::vec& w,
+                           arma::uvec& g,
+                           const TimeGroups& groups,
+                           bool pred_is_risklike){
+
   // note: g must have only values of 0 and 1 to use this.
-  // note: this is a little different in its approach than
-  //       the analogous function for vec g. The reason it
-  //       is different is that I've benchmarked these across
-  //       big and small data and this version works best for
-  //       uvec g while the analogous approach works best for
-  //       vec g.
+  // note: with g in {0, 1}, the pairs of an event only need the
+  //       count and weight of comparable rows with g of 0 and 1,
+  //       so walking backwards and keeping running sums makes this
+  //       linear in the number of rows instead of quadratic.
 
-  vec y_time   = y.unsafe_col(0);
   vec y_status = y.unsafe_col(1);
 
   double total=0, concordant=0;
 
-  for (uword i = 0; i < y.n_rows; ++i) {
+  // running sums over rows in later tie groups (all comparable)
+  double n_later=0, w_later=0, n_later_g1=0, w_later_g1=0;
 
-   if(y_status[i] == 1){
+  for (uword k = groups.rank.n_elem; k-- > 0; ){
 
-    bool g_0 = g[i] == 0;
+   // running sums over censored rows after row i in this group
+   // (ties are not counted unless the later row is censored)
+   double n_cens=0, w_cens=0, n_cens_g1=0, w_cens_g1=0;
 
-    for(uword j = i; j < y.n_rows; ++j){
-     // ties not counted
-     if (y_time[j] > y_time[i] || y_status[j] == 0) {
+   for (uword i = groups.start[k+1]; i-- > groups.start[k]; ) {
 
-      total += ( (w[i]+w[j]) / 2 );
+    if(y_status[i] == 1){
 
-      // time_i < time_j, and person i had an event,
-      // => if risk_i > risk_j we are concordant.
-      // if risk_i is 0, risk_j cannot be less than risk_i
-      // => best case scenario is a tie, i.e., g[j] == 0
-      // => if g[j] is 0, we want to add 1/2 to concordant
-      // => if g[j] is 1, we want to do nothing
-      // => subtract 1 from g, multiply by -1, divide by 2
-      if(g_0){
+     double n_all = n_later + n_cens;
+     double w_all = w_later + w_cens;
+     double n_g1  = n_later_g1 + n_cens_g1;
+     double w_g1  = w_later_g1 + w_cens_g1;
+     double n_g0  = n_all - n_g1;
+     double w_g0  = w_all - w_g1;
 
-       if(g[j] == 0) concordant += ( (w[i]+w[j]) / 4 );
+     total += (n_all * w[i] + w_all) / 2;
 
-      } else if (g[j] == 1){
+     // time_i < time_j, and person i had an event,
+     // => if risk_i > risk_j we are concordant.
+     // if risk_i is 0, the best case for risk_j is a tie (g[j] is 0)
+     // if risk_i is 1, g[j] of 1 is a tie and g[j] of 0 is concordant
+     if(g[i] == 0){
+      concordant += (n_g0 * w[i] + w_g0) / 4;
+     } else {
+      concordant += (n_g1 * w[i] + w_g1) / 4;
+      concordant += (n_g0 * w[i] + w_g0) / 2;
+     }
 
-       // if risk_i is 1 and risk_j is 1, a tie
-       concordant += ( (w[i]+w[j]) / 4 );
+    } else {
 
-      } else {
+     n_cens += 1;
+     w_cens += w[i];
 
-       // if risk_i is 1 and risk_j is 0, concordance
-       concordant += ( (w[i]+w[j]) / 2 );
+     if(g[i] == 1){
+      n_cens_g1 += 1;
+      w_cens_g1 += w[i];
+     }
 
-      }
+    }
 
-     }
+   }
+
+   // every row in this group is comparable to earlier groups
+   for (uword i = groups.start[k]; i < groups.start[k+1]; ++i) {
 
+    n_later += 1;
+    w_later += w[i];
+
+    if(g[i] == 1){
+     n_later_g1 += 1;
+     w_later_g1 += w[i];
     }
 
    }
@@ -519,6 +620,49 @@
   return(ans);
  }
 
+ double compute_gini(double w_left, double y_left,
+                     double w_right, double y_right){
+
+  double p_left = y_left / w_left;
+  double p_right = y_right / w_right;
+
+  // for two classes, 1 - p^2 - (1-p)^2 is 2p(1-p)
+  double gini_left = 2 * p_left * (1 - p_left);
+  double gini_right = 2 * p_right * (1 - p_right);
+
+  double w_total = w_left + w_right;
+
+  return(gini_right * (w_right/w_total) + gini_left * (w_left/w_total));
+
+ }
+
+ double compute_cstat_clsf(double w_left, double y_left,
+                           double w_right, double y_right){
+
+  // right is predicted positive, left is predicted negative
+  double sens = y_right / w_right;
+  double spec = (w_left - y_left) / w_left;
+
+  return(0.5 * (sens + spec));
+
+ }
+
+ double compute_var_reduction(double w_left, double y_left,
+                              double w_right, double y_right){
+
+  // the weighted sum of squares around a mean is S2 - S1^2 / W, and
+  // S2 (the sum of w * y^2) is the same before and after the split
+  double w_total = w_left + w_right;
+  double y_total = y_left + y_right;
+
+  double ans = y_left * y_left / w_left +
+   y_right * y_right / w_right -
+   y_total * y_total / w_total;
+
+  return(ans / w_total);
+
+ }
+
  double compute_mse(arma::vec& y,
                     arma::vec& w,
                     arma::vec& p){
@@ -596,6 +740,75 @@
 
  }
 
+ // the weighted gram matrix of [1, x], i.e., [1, x]' diag(w) [1, x],
+ // without adding an intercept column to x
+ static void compute_gram(const arma::mat& x,
+                          const arma::vec& w,
+                          WlsWorkspace& ws){
+
+  uword n_vars = x.n_cols;
+
+  ws.gram.set_size(n_vars + 1, n_vars + 1);
+
+  ws.gram.at(0, 0) = accu(w);
+
+  for(uword j = 0; j < n_vars; ++j){
+
+   ws.wx = w % x.col(j);
+
+   ws.gram.at(0, j+1) = accu(ws.wx);
+
+   for(uword k = 0; k <= j; ++k){
+    ws.gram.at(k+1, j+1) = dot(ws.wx, x.col(k));
+   }
+
+  }
+
+  ws.gram = symmatu(ws.gram);
+
+ }
+
+ // the cross product of [1, x] with z, i.e., [1, x]' z
+ static void compute_rhs(const arma::mat& x,
+                         const arma::vec& z,
+                         WlsWorkspace& ws){
+
+  ws.rhs.set_size(x.n_cols + 1);
+
+  ws.rhs[0] = accu(z);
+
+  for(uword j = 0; j < x.n_cols; ++j){
+   ws.rhs[j+1] = dot(x.col(j), z);
+  }
+
+ }
+
+ // solves gram * beta = rhs using the cholesky factor of gram,
+ // which is kept in ws.chol_factor for compute_gram_inv_diag()
+ static bool solve_gram(WlsWorkspace& ws, arma::vec& beta){
+
+  if(!chol(ws.chol_factor, ws.gram)) return(false);
+
+  // gram = R'R, so solve R'u = rhs and then R beta = u
+  ws.u = solve(trimatl(ws.chol_factor.t()), ws.rhs);
+  beta = solve(trimatu(ws.chol_factor), ws.u);
+
+  return(true);
+
+ }
+
+ // diagonal of the inverse of gram, i.e., the row sums of squares
+ // of R^-1, from the cholesky factor R found by solve_gram()
+ static bool compute_gram_inv_diag(WlsWorkspace& ws, arma::vec& out){
+
+  if(!inv(ws.chol_inv, trimatu(ws.chol_factor))) return(false);
+
+  out = sum(square(ws.chol_inv), 1);
+
+  return(true);
+
+ }
+
  arma::mat linreg_fit(arma::mat& x_node,
                       arma::mat& y_node,
                       arma::vec& w_node,
@@ -603,28 +816,45 @@
                       double epsilon,
                       arma::uword iter_max){
 
+  FitOptions options = {do_scale, 0, epsilon, iter_max, true, nullptr};
+
+  WlsWorkspace ws;
+
+  return(linreg_fit(x_node, y_node, w_node, options, ws));
+
+ }
+
+ arma::mat linreg_fit(arma::mat& x_node,
+                      arma::mat& y_node,
+                      arma::vec& w_node,
+                      const FitOptions& options,
+                      WlsWorkspace& ws){
+
+  bool do_scale = options.do_scale;
+
   mat x_transforms;
 
   if(do_scale) x_transforms = scale_x(x_node, w_node);
 
-  // Add an intercept column to the design matrix
-  vec intercept(x_node.n_rows, fill::ones);
-  mat X = join_horiz(intercept, x_node);
+  // the intercept is part of the fit but not the output. Including
+  // it is important for computing p-values of other coefficients.
+  uword n_coef = x_node.n_cols + 1;
 
-  // for later steps we don't care about the intercept term b/c we don't
-  // need it, but in this step including the intercept is important
-  // for computing p-values of other regression coefficients.
+  uword resid_df = x_node.n_rows - n_coef;
 
-  uword resid_df = X.n_rows - X.n_cols;
+  vec y = y_node.unsafe_col(0);
 
-  vec beta;
+  ws.resid = w_node % y;
 
-  bool nonsingular = solve(beta,
-                           X.t() * diagmat(w_node) * X,
-                           X.t() * (w_node % y_node),
-                           solve_opts::no_approx);
+  compute_gram(x_node, w_node, ws);
+  compute_rhs(x_node, ws.resid, ws);
 
-  if(!nonsingular){
+  // one weighted least squares solve
+  if(options.n_iter) (*options.n_iter)++;
+
+  vec beta;
+
+  if(!solve_gram(ws, beta)){
    mat result(x_node.n_cols, 2, fill::zeros);
    return(result);
   }
@@ -636,35 +866,44 @@
    return(result);
   }
 
-  vec resid  = y_node - X * beta;
+  if(!options.compute_pvalues){
+   if(do_scale) unscale_coefs(x_node, beta, x_transforms);
+   return(beta.tail(x_node.n_cols));
+  }
+
+  ws.xb = x_node * beta.tail(x_node.n_cols);
 
-  double s2 = as_scalar(trans(resid) * (w_node % resid) / (resid_df));
+  double s2 = 0;
+
+  for(uword i = 0; i < x_node.n_rows; ++i){
+   double resid = y[i] - beta[0] - ws.xb[i];
+   s2 += w_node[i] * resid * resid;
+  }
 
-  mat xtx_inverse;
+  s2 /= resid_df;
 
-  bool invertible = inv(xtx_inverse, X.t() * diagmat(w_node) * X);
+  vec beta_var;
 
-  if(!invertible) {
+  // the factor from solving for beta gives the inverse for free
+  if(!compute_gram_inv_diag(ws, beta_var)){
    mat result(x_node.n_cols, 2, fill::zeros);
    return(result);
   }
 
-  mat beta_cov = s2 * xtx_inverse;
-
-  vec beta_var = diagvec(beta_cov);
+  beta_var *= s2;
 
   if(do_scale) unscale_outputs(x_node, beta, beta_var, x_transforms);
 
   vec tscores = beta / sqrt(beta_var);
 
   // Calculate two-tailed p-values
-  vec pvalues(X.n_cols);
+  vec pvalues(n_coef);
 
-  for (uword i = 0; i < X.n_cols; ++i) {
+  for (uword i = 0; i < n_coef; ++i) {
 
    double tstat = std::abs(tscores[i]);
 
-   pvalues[i] = 2 * (1 - R::pt(tstat, resid_df, 1, 0));
+   pvalues[i] = 2 * (1 - pt(tstat, resid_df, true));
 
   }
 
@@ -681,46 +920,68 @@
                       double epsilon,
                       arma::uword iter_max){
 
+  FitOptions options = {do_scale, 0, epsilon, iter_max, true, nullptr};
+
+  WlsWorkspace ws;
+
+  return(logreg_fit(x_node, y_node, w_node, options, ws));
+
+ }
+
+ arma::mat logreg_fit(arma::mat& x_node,
+                      arma::mat& y_node,
+                      arma::vec& w_node,
+                      const FitOptions& options,
+                      WlsWorkspace& ws){
+
+  bool do_scale = options.do_scale;
+  double epsilon = options.epsilon;
+  arma::uword iter_max = options.iter_max;
+
   mat x_transforms;
 
   if(do_scale) x_transforms = scale_x(x_node, w_node);
 
-  // Add an intercept column to the design matrix
-  vec intercept(x_node.n_rows, fill::ones);
-  const mat X = join_horiz(intercept, x_node);
+  // the intercept is part of the fit but not the output. Including
+  // it is important for computing p-values of other coefficients.
+  uword n_coef = x_node.n_cols + 1;
+
+  vec y = y_node.unsafe_col(0);
 
-  // for later steps we don't care about the intercept term b/c we don't
-  // need it, but in this step including the intercept is important
-  // for computing p-values of other regression coefficients.
+  vec beta(n_coef, fill::zeros);
+  vec update;
 
-  vec beta(X.n_cols, fill::zeros);
-  mat hessian(X.n_cols, X.n_cols);
+  // true if ws.chol_factor holds the factor of the current hessian
+  bool factored = false;
 
   for (uword iter = 0; iter < iter_max; ++iter) {
 
-   vec eta = X * beta;
+   if(options.n_iter) (*options.n_iter)++;
 
-   // needs to be element-wise b/c valgrind
-   // spots a possible memory leak otherwise
-   for(uword i = 0; i < eta.size(); i++){
-    eta[i] = exp(eta[i]);
-   }
+   ws.xb = x_node * beta.tail(x_node.n_cols);
 
-   vec pi = eta / (1 + eta);
-   vec w = w_node % pi % (1 - pi);
+   ws.w_irls.set_size(x_node.n_rows);
+   ws.resid.set_size(x_node.n_rows);
 
-   vec gradient = X.t() * ((y_node - pi) % w_node);
-   hessian = -X.t() * diagmat(w) * X;
+   for(uword i = 0; i < x_node.n_rows; i++){
+    double eta = exp(beta[0] + ws.xb[i]);
+    double pi = eta / (1 + eta);
+    ws.w_irls[i] = w_node[i] * pi * (1 - pi);
+    ws.resid[i] = (y[i] - pi) * w_node[i];
+   }
 
-   vec update;
+   // the hessian is -1 times the gram matrix with IRLS weights, and
+   // the gradient is the cross product of [1, x] with w * (y - pi).
+   compute_gram(x_node, ws.w_irls, ws);
+   compute_rhs(x_node, ws.resid, ws);
 
-   bool invertible = solve(update, hessian, gradient, solve_opts::no_approx);
+   factored = solve_gram(ws, update);
 
-   if(!invertible) break;
+   if(!factored) break;
 
-   beta -= update;
+   beta += update;
 
-   if (norm(gradient) < epsilon) {
+   if (norm(ws.rhs) < epsilon) {
     break;
    }
   }
@@ -732,17 +993,25 @@
    return(result);
   }
 
-  mat inv_hess;
+  // a hessian that could not be factored gives no usable fit
+  if(!factored){
+   mat result(x_node.n_cols, 2, fill::zeros);
+   return(result);
+  }
+
+  if(!options.compute_pvalues){
+   if(do_scale) unscale_coefs(x_node, beta, x_transforms);
+   return(beta.tail(x_node.n_cols));
+  }
 
-  bool invertible = inv(inv_hess, -hessian);
+  vec beta_var;
 
-  if(!invertible){
+  // the last factor gives the inverse hessian without another fit
+  if(!compute_gram_inv_diag(ws, beta_var)){
    mat result(x_node.n_cols, 2, fill::zeros);
    return(result);
   }
 
-  vec beta_var = inv_hess.diag();
-
   if(do_scale) unscale_outputs(x_node, beta, beta_var, x_transforms);
 
   // Compute standard errors, z-scores, and p-values
@@ -815,6 +1084,16 @@
 
  }
 
+ void unscale_coefs(arma::mat& x,
+                    arma::vec& beta,
+                    arma::mat& x_transforms){
+
+  vec beta_var(beta.n_elem);
+
+  unscale_outputs(x, beta, beta_var, x_transforms);
+
+ }
+
  void predict_class(arma::mat& pred){
 
   // modify column 0
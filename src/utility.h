@@ -7,8 +7,7 @@ aorsf may be modified and distributed under the terms of the MIT license.
 #ifndef UTILITY_H
 #define UTILITY_H
 
-#include <armadillo>
-#include <Rcpp.h>
+#include "Runtime.h"
 #include "globals.h"
 
 
@@ -26,6 +25,47 @@ aorsf may be modified and distributed under the terms of the MIT license.
 
  arma::vec find_unique_event_times(arma::mat& y);
 
+ // integer time ranks
+ //
+ // @description ranks let survival kernels find tied times by
+ //   comparing integers. If k is the number of event times < t,
+ //   the rank of t is 2k + 1 when t is an event time and 2k
+ //   otherwise. Ranks order times the same way as the times do, and
+ //   censored times between the same two event times share a rank,
+ //   which no kernel needs to tell apart. The event time index of an
+ //   odd rank r is (r - 1) / 2.
+ //
+ // @param y_time times, in any order
+ // @param event_times unique event times, ascending
+ //
+ arma::uvec find_time_ranks(const arma::vec& y_time,
+                            const arma::vec& event_times);
+
+ // tie groups of survival data sorted by time
+ //
+ // @description rows [start[k], start[k+1]) of y share the time rank
+ //   rank[k]. weight[k] and events[k] hold the sum of w and of
+ //   w * status in group k. These do not depend on a split, so they
+ //   are found once per node and shared by every split and leaf
+ //   computation in the node.
+ //
+ struct TimeGroups {
+  arma::uvec start;
+  arma::uvec rank;
+  arma::vec weight;
+  arma::vec events;
+ };
+
+ void find_time_groups(arma::mat& y,
+                       arma::vec& w,
+                       const arma::uvec& y_rank,
+                       TimeGroups& groups);
+
+ // convenience for callers that only have y (e.g., tests)
+ void find_time_groups(arma::mat& y,
+                       arma::vec& w,
+                       TimeGroups& groups);
+
 
  void print_mat(arma::mat& x,
                 std::string label,
@@ -55,18 +95,15 @@ aorsf may be modified and distributed under the terms of the MIT license.
   */
  std::string beautifyTime(uint seconds);
 
- static void chkIntFn(void *dummy) {
-  R_CheckUserInterrupt();
- }
-
- inline bool checkInterrupt() {
-  return (R_ToplevelExec(chkIntFn, NULL) == FALSE);
- }
-
  double compute_logrank(arma::mat& y,
                         arma::vec& w,
                         arma::uvec& g);
 
+ double compute_logrank(arma::mat& y,
+                        arma::vec& w,
+                        arma::uvec& g,
+                        const TimeGroups& groups);
+
  double compute_cstat_surv(arma::mat& y,
                            arma::vec& w,
                            arma::vec& p,
@@ -77,6 +114,12 @@ aorsf may be modified and distributed under the terms of the MIT license.
                            arma::uvec& g,
                            bool pred_is_risklike);
 
+ double compute_cstat_surv(arma::mat& y,
+                           arma::vec& w,
+                           arma::uvec& g,
+                           const TimeGroups& groups,
+                           bool pred_is_risklike);
+
  double compute_cstat_clsf(arma::vec& y,
                            arma::vec& w,
                            arma::vec& p);
@@ -97,6 +140,27 @@ aorsf may be modified and distributed under the terms of the MIT license.
                      arma::vec& w,
                      arma::uvec& g);
 
+ // split scores from weighted sums over each side of a cut
+ //
+ // @description these give the same scores as compute_gini,
+ //   compute_cstat_clsf, and compute_var_reduction, but take sums that
+ //   trees update as rows move from the right node to the left node
+ //   (see Tree::find_best_cut), so scoring a cut is O(1).
+ //
+ // @param w_left,w_right the sum of weights in each node
+ // @param y_left,y_right the weighted sum of y in each node; y is
+ //   binary for gini and cstat. For variance reduction, y may be
+ //   shifted by any constant (centering it avoids cancellation).
+ //
+ double compute_gini(double w_left, double y_left,
+                     double w_right, double y_right);
+
+ double compute_cstat_clsf(double w_left, double y_left,
+                           double w_right, double y_right);
+
+ double compute_var_reduction(double w_left, double y_left,
+                              double w_right, double y_right);
+
  double compute_var_reduction(arma::vec& y,
                               arma::vec& w,
                               arma::uvec& g);
@@ -107,6 +171,61 @@ aorsf may be modified and distributed under the terms of the MIT license.
  double compute_pred_mean(arma::mat& y,
                           arma::vec& w);
 
+ // settings for the regression fits that find linear combinations
+ //
+ // @description trees fill this in once, in Tree::grow(). P-values
+ //   are only used by anova importance, so when compute_pvalues is
+ //   false, fits skip the matrix inverse and distribution functions
+ //   that p-values need and return coefficients only (one column).
+ //   If n_iter is not null, fits add the number of iterations they
+ //   used to it.
+ //
+ struct FitOptions {
+  bool do_scale;
+  int ties_method;
+  double epsilon;
+  arma::uword iter_max;
+  bool compute_pvalues;
+  arma::uword* n_iter;
+ };
+
+ // memory reused by linreg_fit() and logreg_fit()
+ //
+ // @description Forest::grow() makes one of these per thread, and
+ //   each tree that thread grows borrows it, so the memory is reused
+ //   for every node of every tree on that thread instead of being
+ //   allocated for each fit. It is not thread safe: never share one
+ //   between threads, and don't expect its contents to persist from
+ //   one fit to the next.
+ //
+ struct WlsWorkspace {
+  // weighted gram matrix of [1, x_node] and its cholesky factor, R
+  arma::mat gram;
+  arma::mat chol_factor;
+  // R^-1, used for the variance of coefficients
+  arma::mat chol_inv;
+  // right hand side of the normal equations and R' \ rhs
+  arma::vec rhs;
+  arma::vec u;
+  // one column of x_node times the weights
+  arma::vec wx;
+  // x_node times coefficients (no intercept)
+  arma::vec xb;
+  // IRLS weights and weighted residuals
+  arma::vec w_irls;
+  arma::vec resid;
+ };
+
+ // linear and logistic regression, with an intercept
+ //
+ // @description the weighted gram matrix of [1, x_node] is formed
+ //   without copying x_node, factored once with cholesky, and the
+ //   same factor gives the variances used for p-values.
+ //
+ // @return a matrix with one row per column of x_node; column 0 has
+ //   coefficients and column 1 (if options.compute_pvalues) has
+ //   p-values.
+ //
  arma::mat linreg_fit(arma::mat& x_node,
                       arma::mat& y_node,
                       arma::vec& w_node,
@@ -114,6 +233,12 @@ aorsf may be modified and distributed under the terms of the MIT license.
                       double epsilon,
                       arma::uword iter_max);
 
+ arma::mat linreg_fit(arma::mat& x_node,
+                      arma::mat& y_node,
+                      arma::vec& w_node,
+                      const FitOptions& options,
+                      WlsWorkspace& ws);
+
  arma::mat logreg_fit(arma::mat& x_node,
                       arma::mat& y_node,
                       arma::vec& w_node,
@@ -121,6 +246,12 @@ aorsf may be modified and distributed under the terms of the MIT license.
                       double epsilon,
                       arma::uword iter_max);
 
+ arma::mat logreg_fit(arma::mat& x_node,
+                      arma::mat& y_node,
+                      arma::vec& w_node,
+                      const FitOptions& options,
+                      WlsWorkspace& ws);
+
  arma::mat scale_x(arma::mat& x,
                    arma::vec& w);
 
@@ -129,6 +260,11 @@ aorsf may be modified and distributed under the terms of the MIT license.
                       arma::vec& beta_var,
                       arma::mat& x_transforms);
 
+ // unscale_outputs() for fits without variances
+ void unscale_coefs(arma::mat& x,
+                    arma::vec& beta,
+                    arma::mat& x_transforms);
+
  void predict_class(arma::mat& pred);
 
  }